@@ -0,0 +1,173 @@
+// errors.cpp
+
+/*
+ *   scalc - A simple calculator
+ *   Copyright (C) 2010  Alexander Korsunsky
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compares the throughput of scalc on clean input with the throughput on
+// input where some of the lines are invalid, half of them syntax errors and
+// half of them numeric errors.
+//
+// Usage: scalc-bench-errors <scalc-executable> [<lines> [<invalid percent>]]
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstdio>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+namespace {
+
+// each input is run this often, the fastest run counts
+const unsigned runs = 5;
+
+double now()
+{
+    timeval tv;
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// write the input file, return false if it could not be written
+bool write_input(const char* filename, unsigned long lines, unsigned invalid)
+{
+    std::ofstream out(filename);
+
+    for (unsigned long i = 0; i < lines; ++i)
+    {
+        unsigned a = rand() % 1000, b = rand() % 1000 + 1;
+
+        if (static_cast<unsigned>(rand() % 100) < invalid)
+        {
+            if (rand() % 2)
+                out<<a<<" * ("<<b<<" + )\n";
+            else
+                out<<a<<" / ("<<b<<" - "<<b<<")\n";
+        }
+        else
+            out<<a<<" * ("<<b<<" + 2.5) - "<<a<<" / "<<b<<'\n';
+    }
+
+    return out.good();
+}
+
+// run scalc on a file, return the time in seconds or -1 if it failed
+double run(const char* executable, const char* filename)
+{
+    double start = now();
+
+    pid_t pid = fork();
+    if (pid < 0)
+        return -1;
+
+    if (pid == 0)
+    {
+        // discard the output, only the time to exit is of interest
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+
+        execl(executable, executable, filename, static_cast<char*>(NULL));
+        _exit(127);
+    }
+
+    int status;
+    if (waitpid(pid, &status, 0) != pid ||
+        !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return -1;
+
+    return now() - start;
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr<<"Usage: "<<argv[0]
+            <<" <scalc-executable> [<lines> [<invalid percent>]]\n";
+        return 1;
+    }
+
+    unsigned long lines = 1000000;
+    unsigned invalid = 5;
+
+    if (argc > 2)
+        lines = strtoul(argv[2], NULL, 10);
+    if (argc > 3)
+        invalid = strtoul(argv[3], NULL, 10);
+
+    char clean_name[] = "/tmp/scalc-bench-clean-XXXXXX";
+    char dirty_name[] = "/tmp/scalc-bench-dirty-XXXXXX";
+
+    int clean_fd = mkstemp(clean_name);
+    int dirty_fd = mkstemp(dirty_name);
+    if (clean_fd < 0 || dirty_fd < 0)
+    {
+        std::cerr<<"Failed to create input files\n";
+        return 1;
+    }
+    close(clean_fd);
+    close(dirty_fd);
+
+    srand(1);
+    bool written = write_input(clean_name, lines, 0) &&
+        write_input(dirty_name, lines, invalid);
+
+    // alternate between the inputs, so both see the same system load
+    double clean_time = -1, dirty_time = -1;
+    for (unsigned i = 0; written && i < runs; ++i)
+    {
+        double clean = run(argv[1], clean_name);
+        double dirty = run(argv[1], dirty_name);
+
+        if (clean < 0 || dirty < 0)
+        {
+            clean_time = dirty_time = -1;
+            break;
+        }
+
+        if (i == 0 || clean < clean_time)
+            clean_time = clean;
+        if (i == 0 || dirty < dirty_time)
+            dirty_time = dirty;
+    }
+
+    remove(clean_name);
+    remove(dirty_name);
+
+    if (clean_time < 0 || dirty_time < 0)
+    {
+        std::cerr<<"Failed to run "<<argv[1]<<'\n';
+        return 1;
+    }
+
+    std::cout<<"lines: "<<lines<<", invalid: "<<invalid<<"%\n\n";
+    std::cout<<"input\tlines/s\n";
+    std::cout<<"clean\t"<<lines / clean_time<<'\n';
+    std::cout<<"dirty\t"<<lines / dirty_time<<'\n';
+    std::cout<<"\nclean/dirty throughput: "<<dirty_time / clean_time<<'\n';
+
+    return 0;
+}
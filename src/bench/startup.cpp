@@ -0,0 +1,138 @@
+// startup.cpp
+
+/*
+ *   scalc - A simple calculator
+ *   Copyright (C) 2010  Alexander Korsunsky
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Measures the time from exec to exit of scalc for a single expression,
+// once piped into stdin as a shell script would do it and once given with -e.
+//
+// Usage: scalc-bench-startup <scalc-executable> [<invocations>]
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+namespace {
+
+const char* expression = "1 + 2 * 3";
+
+double now()
+{
+    timeval tv;
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// run scalc once, return false if it could not be run
+bool run(char* const* args, bool pipe_expression)
+{
+    int fds[2];
+    if (pipe_expression && pipe(fds) != 0)
+        return false;
+
+    pid_t pid = fork();
+    if (pid < 0)
+        return false;
+
+    if (pid == 0)
+    {
+        // discard the output, only the time to exit is of interest
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+
+        if (pipe_expression)
+        {
+            dup2(fds[0], STDIN_FILENO);
+            close(fds[0]);
+            close(fds[1]);
+        }
+
+        execv(args[0], args);
+        _exit(127);
+    }
+
+    if (pipe_expression)
+    {
+        close(fds[0]);
+        ssize_t written = write(fds[1], expression, strlen(expression));
+        written += write(fds[1], "\n", 1);
+        close(fds[1]);
+    }
+
+    int status;
+    if (waitpid(pid, &status, 0) != pid)
+        return false;
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// run scalc repeatedly, return the average time per invocation in seconds
+double measure(char* const* args, bool pipe_expression, unsigned invocations)
+{
+    double start = now();
+
+    for (unsigned i = 0; i < invocations; ++i)
+    {
+        if (!run(args, pipe_expression))
+        {
+            std::cerr<<"Failed to run "<<args[0]<<'\n';
+            exit(1);
+        }
+    }
+
+    return (now() - start) / invocations;
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr<<"Usage: "<<argv[0]<<" <scalc-executable> [<invocations>]\n";
+        return 1;
+    }
+
+    unsigned invocations = 10000;
+    if (argc > 2)
+        invocations = strtoul(argv[2], NULL, 10);
+
+    char* stdin_args[] = { argv[1], NULL };
+    char* expression_args[] = {
+        argv[1], const_cast<char*>("-e"), const_cast<char*>(expression), NULL
+    };
+
+    double stdin_time = measure(stdin_args, true, invocations);
+    double expression_time = measure(expression_args, false, invocations);
+
+    std::cout<<"invocations: "<<invocations<<"\n\n";
+    std::cout<<"mode\t\tus/invocation\n";
+    std::cout<<"stdin pipe\t"<<stdin_time * 1e6<<'\n';
+    std::cout<<"-e\t\t"<<expression_time * 1e6<<'\n';
+
+    return 0;
+}
@@ -0,0 +1,153 @@
+// tree_layout.cpp
+
+/*
+ *   scalc - A simple calculator
+ *   Copyright (C) 2010  Alexander Korsunsky
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compares memory per node and evaluation speed of trees made of Expression
+// objects and trees kept in an ExpressionStore.
+//
+// Usage: scalc-bench-tree-layout [<nodes> [<repetitions>]]
+
+#include <iostream>
+#include <cstdlib>
+#include <ctime>
+
+#if defined(__GLIBC__)
+#   include <malloc.h>
+#endif
+
+#include "parsing/semantic.hpp"
+#include "parsing/expression_store.hpp"
+
+namespace {
+
+// bytes currently allocated from the heap, 0 if we can not tell
+std::size_t heap_in_use()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    // large blocks are mmap()ed and not part of uordblks
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+// build a balanced tree with the given number of nodes
+Expression::ptr_t build_tree(unsigned long nodes)
+{
+    if (nodes == 1)
+    {
+        // small numbers, so that the result does not overflow
+        NumericValue val;
+        if (rand() % 2)
+        {
+            val.value.exact = rand() % 3 + 1;
+            val.value_type = NumericValue::EXACT;
+        }
+        else
+        {
+            val.value.floating = 0.5 + rand() / (RAND_MAX + 1.);
+            val.value_type = NumericValue::FLOATING;
+        }
+
+        return Expression::ptr_t(new NumericExpression(val));
+    }
+
+    if (nodes == 2)
+        return Expression::ptr_t(
+            new UnaryOperation(build_tree(1), &negation_op));
+
+    // no multiplications, a product of millions of numbers overflows
+    static const BinaryOperation::binary_operation_t operations[] = {
+        &plus_op, &minus_op
+    };
+
+    unsigned long lhs_nodes = (nodes - 1) / 2;
+    Expression::ptr_t lhs = build_tree(lhs_nodes);
+    Expression::ptr_t rhs = build_tree(nodes - 1 - lhs_nodes);
+
+    return Expression::ptr_t(
+        new BinaryOperation(lhs, rhs, operations[rand() % 2]));
+}
+
+double seconds_since(std::clock_t start)
+{ return static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC; }
+
+} // anonymous namespace
+
+
+int main(int argc, char** argv)
+{
+    unsigned long nodes = 10000001;
+    unsigned repetitions = 5;
+
+    if (argc > 1)
+        nodes = strtoul(argv[1], NULL, 10);
+    if (argc > 2)
+        repetitions = strtoul(argv[2], NULL, 10);
+
+    if (nodes == 0 || repetitions == 0)
+    {
+        std::cerr<<"Usage: "<<argv[0]<<" [<nodes> [<repetitions>]]\n";
+        return 1;
+    }
+
+    srand(1);
+
+    // pointer tree
+    std::size_t heap_before = heap_in_use();
+    Expression::ptr_t tree = build_tree(nodes);
+    std::size_t tree_bytes = heap_in_use() - heap_before;
+
+    std::clock_t start = std::clock();
+    NumericValue tree_value;
+    for (unsigned i = 0; i < repetitions; ++i)
+        tree_value = tree->numeric_value();
+    double tree_time = seconds_since(start) / repetitions;
+
+    // expression store
+    heap_before = heap_in_use();
+    ExpressionStore store;
+    ExpressionStore::index_t root = store.add_expression(*tree);
+    std::size_t store_bytes = heap_in_use() - heap_before;
+
+    start = std::clock();
+    NumericValue store_value;
+    for (unsigned i = 0; i < repetitions; ++i)
+        store_value = store.numeric_value(root);
+    double store_time = seconds_since(start) / repetitions;
+
+    std::cout<<"nodes: "<<nodes<<'\n';
+    std::cout<<"result: "<<tree_value<<" (Expression), "
+        <<store_value<<" (ExpressionStore)\n\n";
+
+    std::cout<<"layout\t\tbytes/node\teval ms\tns/node\n";
+    std::cout<<"Expression\t"
+        <<static_cast<double>(tree_bytes) / nodes<<"\t\t"
+        <<tree_time * 1e3<<'\t'<<tree_time * 1e9 / nodes<<'\n';
+    std::cout<<"ExpressionStore\t"
+        <<static_cast<double>(store_bytes) / nodes<<"\t\t"
+        <<store_time * 1e3<<'\t'<<store_time * 1e9 / nodes<<'\n';
+
+    std::cout<<"\nExpressionStore columns: "
+        <<static_cast<double>(store.memory_usage()) / nodes
+        <<" bytes/node allocated\n";
+
+    return 0;
+}
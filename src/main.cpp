@@ -23,6 +23,10 @@
 #include <stdexcept>
 
 #include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+#include <string>
 
 #include "parsing/parsing.hpp"
 
@@ -32,6 +36,14 @@ const char* usage_string =
 #if defined(YYDEBUG)
     "\t-d:\t\tDisplay parser debug information on error\n"
 #endif
+#if defined(SCALC_JIT)
+    "\t-j:\t\tCompile expressions to native code before evaluating them.\n"
+    "\t\tEach statement is compiled for a single run, this checks the\n"
+    "\t\tcode generator and is slower than the default evaluation.\n"
+#endif
+    "\t--max-errors <n>: Stop after <n> errors\n"
+    "\t-e <expr>:\tEvaluate <expr> instead of reading input. Can be given\n"
+    "\t\tmore than once. Exits with status 1 if any expression fails.\n"
     "\n"
     "\t<inputfile>:\tInput file for reading operations. If not specified,\n"
     "\t\tread from stdin.\n"
@@ -40,12 +52,20 @@ const char* usage_string =
 int main(int argc, char** argv)
 {
     ParserOptions parser_options = {
-        false
+        false,
+        false,
+        NULL
     };
 
+    // stop after this many errors, 0 for no limit
+    unsigned long max_errors = 0;
+
     // name of the input file, NULL if reading from stdin
     char *infilename = NULL;
 
+    // expressions given with -e, one per line
+    std::string expressions;
+
     unsigned positional_count = 0;
 
     // iterate through arguments, retrieve options
@@ -61,6 +81,42 @@ int main(int argc, char** argv)
         else if (!strcmp("-d", argv[i]) || !strcmp("--debug", argv[i]))
             yydebug = 1;
 #endif
+#if defined(SCALC_JIT)
+        // compile expressions when -j option is specified
+        else if (!strcmp("-j", argv[i]) || !strcmp("--jit", argv[i]))
+            parser_options.use_jit = true;
+#endif
+        // the error limit takes the next argument as value
+        else if (!strcmp("--max-errors", argv[i]))
+        {
+            char* endptr = NULL;
+            if (i + 1 < argc)
+            {
+                errno = 0;
+                max_errors = strtoul(argv[++i], &endptr, 10);
+            }
+
+            // Diagnostics counts errors in an unsigned int
+            if (endptr == NULL || *endptr != '\0' || max_errors == 0 ||
+                errno == ERANGE || max_errors > UINT_MAX)
+            {
+                std::cerr<<"--max-errors needs a positive number up to "
+                    <<UINT_MAX<<'\n';
+                return 1;
+            }
+        }
+        // collect expressions to evaluate
+        else if (!strcmp("-e", argv[i]) || !strcmp("--expression", argv[i]))
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr<<"-e needs an expression\n";
+                return 1;
+            }
+
+            expressions += argv[++i];
+            expressions += '\n';
+        }
         // retrieve positional options
         else
         {
@@ -79,6 +135,12 @@ int main(int argc, char** argv)
         }
     }
 
+    if (!expressions.empty() && infilename != NULL)
+    {
+        std::cerr<<"Can not read an input file when using -e\n";
+        return 1;
+    }
+
     // set yyin to the input file, if specified
     if (infilename != NULL)
     {
@@ -92,9 +154,28 @@ int main(int argc, char** argv)
         parser_options.file_input = true;
     }
 
+    // errors are collected and written in batches
+    Diagnostics diagnostics(std::cerr, static_cast<unsigned>(max_errors));
+    parser_options.diagnostics = &diagnostics;
+
     // do the parsing
     try {
-        yyparse(parser_options);
+        // evaluate expressions from the command line without prompting
+        if (!expressions.empty())
+        {
+            parser_options.file_input = true;
+
+            // the scanner needs two NULs at the end of its buffer
+            std::size_t length = expressions.size();
+            expressions.append(2, '\0');
+
+            parse_string(&expressions[0], length, parser_options);
+
+            return diagnostics.error_count() != 0;
+        }
+
+        if (yyparse(parser_options) != 0 && diagnostics.limit_reached())
+            return 1;
 
         if (!parser_options.file_input)
             std::cout<<std::endl;
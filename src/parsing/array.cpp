@@ -0,0 +1,556 @@
+// array.cpp
+
+/*
+ *   scalc - A simple calculator
+ *   Copyright (C) 2010  Alexander Korsunsky
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cfloat>
+
+#if defined(__SSE2__)
+#   include <emmintrin.h>
+#endif
+
+#include "array.hpp"
+
+namespace {
+
+// exact operands of floating operations are converted this many elements at
+// a time
+const std::size_t conversion_block = 256;
+
+// the largest array a range may create
+const unsigned long max_range_size = 1UL << 28;
+
+// operator functions for single numbers, indexed by elementwise_op_t
+const BinaryOperation::binary_operation_t scalar_operations[] = {
+    &plus_op,
+    &minus_op,
+    &multiply_op,
+    &divide_op,
+    &pow_op
+};
+
+template <typename T>
+T* data(std::vector<T>& v)
+{ return v.empty() ? NULL : &v[0]; }
+
+template <typename T>
+const T* data(const std::vector<T>& v)
+{ return v.empty() ? NULL : &v[0]; }
+
+template <typename T>
+inline T at(const T* elements, bool broadcast, std::size_t i)
+{ return broadcast ? elements[0] : elements[i]; }
+
+// a single element of an operand
+NumericValue element(const ArrayOperand& operand, std::size_t i)
+{
+    NumericValue val;
+    if (operand.type == NumericValue::EXACT)
+        val.value.exact = at(operand.exact, operand.broadcast, i);
+    else
+        val.value.floating = at(operand.floating, operand.broadcast, i);
+    val.value_type = operand.type;
+
+    return val;
+}
+
+NumericValue array_value(const NumericArray* array)
+{
+    NumericValue val;
+    val.value.array = array;
+    val.value_type = NumericValue::ARRAY;
+
+    return val;
+}
+
+
+// Floating operations, for single numbers and pairs of numbers in SSE2
+// registers. Operands are finite, results are checked afterwards.
+
+struct FloatingPlus
+{
+    static double apply(double lhs, double rhs)
+    { return lhs + rhs; }
+#if defined(__SSE2__)
+    static __m128d apply(__m128d lhs, __m128d rhs)
+    { return _mm_add_pd(lhs, rhs); }
+#endif
+};
+
+struct FloatingMinus
+{
+    static double apply(double lhs, double rhs)
+    { return lhs - rhs; }
+#if defined(__SSE2__)
+    static __m128d apply(__m128d lhs, __m128d rhs)
+    { return _mm_sub_pd(lhs, rhs); }
+#endif
+};
+
+struct FloatingMultiply
+{
+    static double apply(double lhs, double rhs)
+    { return lhs * rhs; }
+#if defined(__SSE2__)
+    static __m128d apply(__m128d lhs, __m128d rhs)
+    { return _mm_mul_pd(lhs, rhs); }
+#endif
+};
+
+// a division by zero gives an infinite or NaN result
+struct FloatingDivide
+{
+    static double apply(double lhs, double rhs)
+    { return lhs / rhs; }
+#if defined(__SSE2__)
+    static __m128d apply(__m128d lhs, __m128d rhs)
+    { return _mm_div_pd(lhs, rhs); }
+#endif
+};
+
+// returns false if any result is not finite
+template <class Op>
+bool floating_loop(const double* lhs, bool lhs_broadcast,
+    const double* rhs, bool rhs_broadcast, std::size_t count, double* out)
+{
+    std::size_t i = 0;
+    bool finite = true;
+
+#if defined(__SSE2__)
+    const __m128d max = _mm_set1_pd(DBL_MAX);
+    const __m128d sign = _mm_set1_pd(-0.);
+    __m128d all_finite = _mm_cmpeq_pd(max, max);
+
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128d l = lhs_broadcast ? _mm_set1_pd(lhs[0]) : _mm_loadu_pd(lhs + i);
+        __m128d r = rhs_broadcast ? _mm_set1_pd(rhs[0]) : _mm_loadu_pd(rhs + i);
+        __m128d result = Op::apply(l, r);
+
+        // |result| <= DBL_MAX is false for infinity and NaN
+        all_finite = _mm_and_pd(all_finite,
+            _mm_cmple_pd(_mm_andnot_pd(sign, result), max));
+
+        _mm_storeu_pd(out + i, result);
+    }
+
+    finite = _mm_movemask_pd(all_finite) == 3;
+#endif
+
+    for (; i < count; ++i)
+    {
+        double result = Op::apply(at(lhs, lhs_broadcast, i),
+            at(rhs, rhs_broadcast, i));
+
+        finite &= std::fabs(result) <= DBL_MAX;
+        out[i] = result;
+    }
+
+    return finite;
+}
+
+// Exact operations. Overflows are collected in the sign bit of the overflow
+// argument, so the loops do not branch.
+
+struct ExactPlus
+{
+    static long int apply(long int lhs, long int rhs, long int& overflow)
+    {
+        long int result = static_cast<long int>(
+            static_cast<unsigned long>(lhs) + static_cast<unsigned long>(rhs));
+
+        // the sign of the result differs from the signs of both operands
+        overflow |= (lhs ^ result) & (rhs ^ result);
+        return result;
+    }
+};
+
+struct ExactMinus
+{
+    static long int apply(long int lhs, long int rhs, long int& overflow)
+    {
+        long int result = static_cast<long int>(
+            static_cast<unsigned long>(lhs) - static_cast<unsigned long>(rhs));
+
+        // the operands have different signs and the result has the sign of rhs
+        overflow |= (lhs ^ rhs) & (lhs ^ result);
+        return result;
+    }
+};
+
+struct ExactMultiply
+{
+    static long int apply(long int lhs, long int rhs, long int& overflow)
+    {
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+        // the overflow flag of the multiplication, instead of a division
+        long int result;
+        overflow |= -static_cast<long int>(
+            __builtin_mul_overflow(lhs, rhs, &result));
+
+        return result;
+#else
+        overflow |= -static_cast<long int>(mul_overflows(lhs, rhs));
+
+        return static_cast<long int>(
+            static_cast<unsigned long>(lhs) * static_cast<unsigned long>(rhs));
+#endif
+    }
+};
+
+template <class Op>
+bool exact_loop(const long int* lhs, bool lhs_broadcast,
+    const long int* rhs, bool rhs_broadcast, std::size_t count, long int* out)
+{
+    long int overflow = 0;
+
+    for (std::size_t i = 0; i < count; ++i)
+        out[i] = Op::apply(at(lhs, lhs_broadcast, i),
+            at(rhs, rhs_broadcast, i), overflow);
+
+    return overflow >= 0;
+}
+
+// return the floating elements [start, start + count) of an operand, exact
+// elements are converted into the buffer
+const double* as_floating(const ArrayOperand& operand, std::size_t start,
+    std::size_t count, double* buffer)
+{
+    if (operand.type == NumericValue::FLOATING)
+        return operand.broadcast ? operand.floating : operand.floating + start;
+
+    if (operand.broadcast)
+    {
+        buffer[0] = static_cast<double>(operand.exact[0]);
+        return buffer;
+    }
+
+    const long int* exact = operand.exact + start;
+    for (std::size_t i = 0; i < count; ++i)
+        buffer[i] = static_cast<double>(exact[i]);
+
+    return buffer;
+}
+
+bool floating_block(elementwise_op_t op,
+    const double* lhs, bool lhs_broadcast,
+    const double* rhs, bool rhs_broadcast, std::size_t count, double* out)
+{
+    switch (op)
+    {
+        case ELEMENTWISE_PLUS:
+            return floating_loop<FloatingPlus>(lhs, lhs_broadcast,
+                rhs, rhs_broadcast, count, out);
+        case ELEMENTWISE_MINUS:
+            return floating_loop<FloatingMinus>(lhs, lhs_broadcast,
+                rhs, rhs_broadcast, count, out);
+        case ELEMENTWISE_MULTIPLY:
+            return floating_loop<FloatingMultiply>(lhs, lhs_broadcast,
+                rhs, rhs_broadcast, count, out);
+        default:
+            return floating_loop<FloatingDivide>(lhs, lhs_broadcast,
+                rhs, rhs_broadcast, count, out);
+    }
+}
+
+// powers are computed by the operator function, one element at a time
+bool pow_loop(const ArrayOperand& lhs, const ArrayOperand& rhs,
+    std::size_t count, long int* exact_out, double* floating_out)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        NumericValue result = pow_op(element(lhs, i), element(rhs, i));
+
+        if (result.value_type == NumericValue::ERROR)
+            return false;
+        else if (result.value_type == NumericValue::EXACT)
+            exact_out[i] = result.value.exact;
+        else
+            floating_out[i] = result.value.floating;
+    }
+
+    return true;
+}
+
+// copy the elements of an operand into an array, converting them if needed
+void copy_elements(const ArrayOperand& operand, std::size_t count,
+    NumericArray& array, std::size_t offset)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        if (array.element_type == NumericValue::EXACT)
+            array.exact[offset + i] = at(operand.exact, operand.broadcast, i);
+        else if (operand.type == NumericValue::EXACT)
+            array.floating[offset + i] = static_cast<double>(
+                at(operand.exact, operand.broadcast, i));
+        else
+            array.floating[offset + i] =
+                at(operand.floating, operand.broadcast, i);
+    }
+}
+
+// arrays created since the last release_all()
+std::vector<NumericArray*> array_pool;
+
+} // anonymous namespace
+
+
+NumericArray* NumericArray::create(NumericValue::value_type_t type,
+    std::size_t size)
+{
+    array_pool.push_back(new NumericArray(type, size));
+
+    return array_pool.back();
+}
+
+void NumericArray::release_all()
+{
+    for (std::size_t i = 0; i < array_pool.size(); ++i)
+        delete array_pool[i];
+
+    array_pool.clear();
+}
+
+ArrayOperand::ArrayOperand(const NumericValue& val)
+{
+    if (val.value_type == NumericValue::ARRAY)
+    {
+        type = val.value.array->element_type;
+        exact = data(val.value.array->exact);
+        floating = data(val.value.array->floating);
+        broadcast = false;
+    }
+    else
+    {
+        type = val.value_type;
+        exact = &val.value.exact;
+        floating = &val.value.floating;
+        broadcast = true;
+    }
+}
+
+bool elementwise_binary(elementwise_op_t op,
+    const ArrayOperand& lhs, const ArrayOperand& rhs, std::size_t count,
+    long int* exact_out, double* floating_out)
+{
+    if (op == ELEMENTWISE_POW)
+        return pow_loop(lhs, rhs, count, exact_out, floating_out);
+
+    if (elementwise_type(op, lhs.type, rhs.type) == NumericValue::EXACT)
+    {
+        switch (op)
+        {
+            case ELEMENTWISE_PLUS:
+                return exact_loop<ExactPlus>(lhs.exact, lhs.broadcast,
+                    rhs.exact, rhs.broadcast, count, exact_out);
+            case ELEMENTWISE_MINUS:
+                return exact_loop<ExactMinus>(lhs.exact, lhs.broadcast,
+                    rhs.exact, rhs.broadcast, count, exact_out);
+            default:
+                return exact_loop<ExactMultiply>(lhs.exact, lhs.broadcast,
+                    rhs.exact, rhs.broadcast, count, exact_out);
+        }
+    }
+
+    double lhs_buffer[conversion_block];
+    double rhs_buffer[conversion_block];
+    bool finite = true;
+
+    for (std::size_t start = 0; start < count; start += conversion_block)
+    {
+        std::size_t block = std::min(count - start, conversion_block);
+
+        const double* l = as_floating(lhs, start, block, lhs_buffer);
+        const double* r = as_floating(rhs, start, block, rhs_buffer);
+
+        finite &= floating_block(op, l, lhs.broadcast, r, rhs.broadcast,
+            block, floating_out + start);
+    }
+
+    return finite;
+}
+
+bool elementwise_negation(const ArrayOperand& operand, std::size_t count,
+    long int* exact_out, double* floating_out)
+{
+    if (operand.type == NumericValue::FLOATING)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            floating_out[i] = -at(operand.floating, operand.broadcast, i);
+
+        return true;
+    }
+
+    // only LONG_MIN has no exact negation
+    long int overflow = 0;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        long int val = at(operand.exact, operand.broadcast, i);
+
+        overflow |= -static_cast<long int>(val == LONG_MIN);
+        exact_out[i] = static_cast<long int>(-static_cast<unsigned long>(val));
+    }
+
+    return overflow >= 0;
+}
+
+
+NumericValue elementwise_op(elementwise_op_t op,
+    const NumericValue& lhs, const NumericValue& rhs)
+{
+    std::size_t count = (lhs.value_type == NumericValue::ARRAY) ?
+        lhs.value.array->size() : rhs.value.array->size();
+
+    if (lhs.value_type == NumericValue::ARRAY &&
+        rhs.value_type == NumericValue::ARRAY &&
+        rhs.value.array->size() != count)
+        return NumericValue().set_error(NumericError::ERR_ARRAY_SIZE);
+
+    ArrayOperand l(lhs), r(rhs);
+    NumericArray* result = NumericArray::create(elementwise_type(op, l.type, r.type), count);
+
+    if (!elementwise_binary(op, l, r, count,
+            data(result->exact), data(result->floating)))
+    {
+        // find the first erroneous element
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            NumericValue val = scalar_operations[op](element(l, i), element(r, i));
+            if (val.value_type == NumericValue::ERROR)
+                return val;
+        }
+    }
+
+    return array_value(result);
+}
+
+NumericValue elementwise_negation(const NumericValue& operand)
+{
+    ArrayOperand elements(operand);
+    std::size_t count = operand.value.array->size();
+
+    NumericArray* result = NumericArray::create(elements.type, count);
+
+    if (!elementwise_negation(elements, count,
+            data(result->exact), data(result->floating)))
+        return NumericValue().set_error(NumericError::ERR_OVERFLOW);
+
+    return array_value(result);
+}
+
+NumericValue array_op(const NumericValue* items, std::size_t count)
+{
+    // a literal with a single array, most often a range, is that array
+    if (count == 1 && items[0].value_type == NumericValue::ARRAY)
+        return items[0];
+
+    // the size and type of the result are known before copying anything
+    std::size_t size = 0;
+    NumericValue::value_type_t type = NumericValue::EXACT;
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        // errors are passed on
+        if (items[i].value_type == NumericValue::ERROR)
+            return items[i];
+
+        ArrayOperand item(items[i]);
+        size += item.broadcast ? 1 : items[i].value.array->size();
+
+        if (item.type == NumericValue::FLOATING)
+            type = NumericValue::FLOATING;
+    }
+
+    NumericArray* result = NumericArray::create(type, size);
+
+    std::size_t offset = 0;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        ArrayOperand item(items[i]);
+        std::size_t item_size = item.broadcast ?
+            1 : items[i].value.array->size();
+
+        copy_elements(item, item_size, *result, offset);
+        offset += item_size;
+    }
+
+    return array_value(result);
+}
+
+NumericValue range_op(const NumericValue& lhs, const NumericValue& rhs)
+{
+    NumericValue retval;
+
+    // errors are passed on
+    if (lhs.value_type == NumericValue::ERROR)
+        return lhs;
+    if (rhs.value_type == NumericValue::ERROR)
+        return rhs;
+
+    if (lhs.value_type == NumericValue::ARRAY ||
+        rhs.value_type == NumericValue::ARRAY)
+        return retval.set_error(NumericError::ERR_RANGE);
+
+    NumericArray* result;
+
+    if (lhs.value_type == NumericValue::EXACT &&
+        rhs.value_type == NumericValue::EXACT)
+    {
+        long int first = lhs.value.exact, last = rhs.value.exact;
+        unsigned long count = 0;
+
+        // the difference of two long ints allways fits into an unsigned long
+        if (first <= last)
+        {
+            unsigned long difference = static_cast<unsigned long>(last) -
+                static_cast<unsigned long>(first);
+            if (difference >= max_range_size)
+                return retval.set_error(NumericError::ERR_OVERFLOW);
+
+            count = difference + 1;
+        }
+
+        result = NumericArray::create(NumericValue::EXACT, count);
+        for (unsigned long i = 0; i < count; ++i)
+            result->exact[i] = first + static_cast<long int>(i);
+    }
+    else
+    {
+        double first = (lhs.value_type == NumericValue::EXACT) ?
+            lhs.value.exact : lhs.value.floating;
+        double last = (rhs.value_type == NumericValue::EXACT) ?
+            rhs.value.exact : rhs.value.floating;
+        unsigned long count = 0;
+
+        if (first <= last)
+        {
+            double difference = std::floor(last - first);
+            if (!(difference < max_range_size))
+                return retval.set_error(NumericError::ERR_OVERFLOW);
+
+            count = static_cast<unsigned long>(difference) + 1;
+        }
+
+        result = NumericArray::create(NumericValue::FLOATING, count);
+        for (unsigned long i = 0; i < count; ++i)
+            result->floating[i] = first + i;
+    }
+
+    return array_value(result);
+}
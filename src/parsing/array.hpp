@@ -0,0 +1,124 @@
+// array.hpp
+
+/*
+ *   scalc - A simple calculator
+ *   Copyright (C) 2010  Alexander Korsunsky
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ARRAY_HPP_
+#define ARRAY_HPP_
+
+#include <cstddef>
+
+#include "semantic.hpp"
+
+/** Arithmetic operations that can be applied element by element */
+enum elementwise_op_t {
+    ELEMENTWISE_PLUS,
+    ELEMENTWISE_MINUS,
+    ELEMENTWISE_MULTIPLY,
+    ELEMENTWISE_DIVIDE,
+    ELEMENTWISE_POW
+};
+
+/** Return the type of the elements an operation produces.
+* The same conversion rules as for single numbers apply: division allways
+* produces FLOATING elements, other operations only stay EXACT if both
+* operands are EXACT.
+*/
+inline NumericValue::value_type_t elementwise_type(elementwise_op_t op,
+    NumericValue::value_type_t lhs, NumericValue::value_type_t rhs)
+{
+    if (op != ELEMENTWISE_DIVIDE &&
+        lhs == NumericValue::EXACT && rhs == NumericValue::EXACT)
+        return NumericValue::EXACT;
+    else
+        return NumericValue::FLOATING;
+}
+
+/** One operand of an element-wise operation.
+*
+* Either points to the contiguous elements of an array or, if broadcast is
+* set, to a single number that is used for every element. Only the pointer
+* matching the type is used.
+*/
+struct ArrayOperand
+{
+    ArrayOperand()
+        : type(NumericValue::EXACT), exact(NULL), floating(NULL),
+        broadcast(false)
+    { }
+
+    /** Create an operand from a number or an array value.
+    * The value has to outlive the operand.
+    */
+    explicit ArrayOperand(const NumericValue& val);
+
+    NumericValue::value_type_t type;
+    const long int* exact;
+    const double* floating;
+    bool broadcast;
+};
+
+/** Apply a binary operation to a range of elements.
+*
+* @param op The operation
+* @param lhs The left hand side operand
+* @param rhs The right hand side operand
+* @param count The number of elements to compute
+* @param exact_out Receives the results if elementwise_type() is EXACT
+* @param floating_out Receives the results if elementwise_type() is FLOATING
+* @return false if any of the elements is an error. Which one and what error
+* is not determined, the contents of the output are undefined then.
+*/
+bool elementwise_binary(elementwise_op_t op,
+    const ArrayOperand& lhs, const ArrayOperand& rhs, std::size_t count,
+    long int* exact_out, double* floating_out);
+
+/** Negate a range of elements.
+* The results have the type of the operand, otherwise the same as
+* elementwise_binary().
+*/
+bool elementwise_negation(const ArrayOperand& operand, std::size_t count,
+    long int* exact_out, double* floating_out);
+
+
+/** Apply a binary operation to each element of one or two arrays.
+* A number operand is combined with every element. Arrays of different sizes
+* yield ERR_ARRAY_SIZE, otherwise the first erroneous element is the result.
+*/
+NumericValue elementwise_op(elementwise_op_t op,
+    const NumericValue& lhs, const NumericValue& rhs);
+
+/** Negate each element of an array */
+NumericValue elementwise_negation(const NumericValue& operand);
+
+/** Create an array from the items of an array literal.
+* Numbers become single elements, the elements of arrays are inserted. The
+* elements are FLOATING if any of the items is. The first erroneous item is
+* passed on. A single array item is returned as it is, without a copy.
+* @param items The values of the items
+* @param count The number of items
+*/
+NumericValue array_op(const NumericValue* items, std::size_t count);
+
+/** Create an array with the numbers from lhs up to including rhs.
+* Consecutive elements differ by one, the array is empty if rhs < lhs. The
+* elements are only EXACT if both bounds are.
+*/
+NumericValue range_op(const NumericValue& lhs, const NumericValue& rhs);
+
+#endif // ifndef ARRAY_HPP_
@@ -0,0 +1,458 @@
+// expression_store.cpp
+
+/*
+ *   scalc - A simple calculator
+ *   Copyright (C) 2010  Alexander Korsunsky
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "expression_store.hpp"
+#include "array.hpp"
+
+namespace {
+
+// operator functions of the binary opcodes, indexed by opcode
+const BinaryOperation::binary_operation_t binary_operations[] = {
+    NULL,           // NUMBER
+    NULL,           // NEGATION
+    &plus_op,
+    &minus_op,
+    &multiply_op,
+    &divide_op,
+    &pow_op,
+    NULL,           // ARRAY
+    &range_op
+};
+
+// Fused evaluation only pays off once the intermediate arrays of the
+// operator functions no longer fit into the L1 cache, for smaller arrays
+// setting up the blocks costs more than it saves. Measured with three
+// operations, unfused evaluation is faster up to 1024 elements and fused
+// evaluation from 4096 elements on.
+const std::size_t fusion_threshold = 2048;
+
+// Elements are computed in blocks of this size. The blocks of all stack
+// levels, 4 KiB each, stay in the L1 cache.
+const std::size_t fusion_block = 512;
+
+// One step of a fused evaluation. Steps are in post-order, like the nodes.
+struct FusedStep
+{
+    // the operation, NUMBER for an operand evaluated before
+    ExpressionStore::opcode_t op;
+
+    // the index of the operand value
+    std::size_t operand;
+
+    // the type of the elements of the result
+    NumericValue::value_type_t type;
+};
+
+// evaluate the steps with the operator functions
+NumericValue run_unfused(const std::vector<FusedStep>& steps,
+    const std::vector<NumericValue>& operands)
+{
+    std::vector<NumericValue> stack;
+
+    for (std::size_t i = 0; i < steps.size(); ++i)
+    {
+        if (steps[i].op == ExpressionStore::NUMBER)
+            stack.push_back(operands[steps[i].operand]);
+
+        else if (steps[i].op == ExpressionStore::NEGATION)
+            stack.back() = negation_op(stack.back());
+
+        else
+        {
+            NumericValue rhs = stack.back();
+            stack.pop_back();
+
+            stack.back() = binary_operations[steps[i].op](stack.back(), rhs);
+        }
+    }
+
+    return stack.back();
+}
+
+// Evaluate the steps block by block, the last step writes into the result.
+// Returns false if any element is an error.
+bool run_fused(const std::vector<FusedStep>& steps,
+    const std::vector<NumericValue>& operands, NumericArray& result)
+{
+    std::size_t count = result.size();
+
+    // the deepest stack needs a block of elements per level
+    std::size_t depth = 0, max_depth = 0;
+    for (std::size_t i = 0; i < steps.size(); ++i)
+    {
+        if (steps[i].op == ExpressionStore::NUMBER)
+            max_depth = std::max(max_depth, ++depth);
+        else if (steps[i].op != ExpressionStore::NEGATION)
+            --depth;
+    }
+
+    std::vector<long int> exact(max_depth * fusion_block);
+    std::vector<double> floating(max_depth * fusion_block);
+
+    std::vector<ArrayOperand> inputs(operands.begin(), operands.end());
+    std::vector<ArrayOperand> stack;
+
+    for (std::size_t start = 0; start < count; start += fusion_block)
+    {
+        std::size_t block = std::min(count - start, fusion_block);
+        stack.clear();
+
+        for (std::size_t i = 0; i < steps.size(); ++i)
+        {
+            if (steps[i].op == ExpressionStore::NUMBER)
+            {
+                ArrayOperand input = inputs[steps[i].operand];
+                if (!input.broadcast)
+                {
+                    if (input.type == NumericValue::EXACT)
+                        input.exact += start;
+                    else
+                        input.floating += start;
+                }
+
+                stack.push_back(input);
+                continue;
+            }
+
+            std::size_t level = stack.size() -
+                (steps[i].op == ExpressionStore::NEGATION ? 1 : 2);
+
+            long int* exact_out = NULL;
+            double* floating_out = NULL;
+
+            if (i + 1 == steps.size())
+            {
+                if (steps[i].type == NumericValue::EXACT)
+                    exact_out = &result.exact[start];
+                else
+                    floating_out = &result.floating[start];
+            }
+            else
+            {
+                exact_out = &exact[level * fusion_block];
+                floating_out = &floating[level * fusion_block];
+            }
+
+            bool valid;
+            if (steps[i].op == ExpressionStore::NEGATION)
+                valid = elementwise_negation(stack[level], block,
+                    exact_out, floating_out);
+            else
+                // the arithmetic opcodes are in the same order as the
+                // element-wise operations
+                valid = elementwise_binary(
+                    static_cast<elementwise_op_t>(
+                        steps[i].op - ExpressionStore::PLUS),
+                    stack[level], stack[level + 1], block,
+                    exact_out, floating_out);
+
+            if (!valid)
+                return false;
+
+            ArrayOperand output;
+            output.type = steps[i].type;
+            output.exact = exact_out;
+            output.floating = floating_out;
+
+            stack.resize(level);
+            stack.push_back(output);
+        }
+    }
+
+    return true;
+}
+
+} // anonymous namespace
+
+
+ExpressionStore::index_t ExpressionStore::add_node(opcode_t op,
+    NumericValue::value_type_t type, index_t lhs, index_t rhs)
+{
+    _opcodes.push_back(static_cast<uint8_t>(op));
+    _types.push_back(static_cast<uint8_t>(type));
+    _lhs.push_back(lhs);
+    _rhs.push_back(rhs);
+
+    return static_cast<index_t>(_opcodes.size() - 1);
+}
+
+ExpressionStore::index_t ExpressionStore::add_number(const NumericValue& val)
+{
+    _values.push_back(val.value);
+
+    return add_node(NUMBER, val.value_type,
+        static_cast<index_t>(_values.size() - 1), 0);
+}
+
+ExpressionStore::index_t ExpressionStore::add_unary(opcode_t op,
+    index_t operand)
+{
+    // negation does not change the type
+    return add_node(op, value_type(operand), operand, 0);
+}
+
+ExpressionStore::index_t ExpressionStore::add_binary(opcode_t op,
+    index_t lhs, index_t rhs)
+{
+    NumericValue::value_type_t type;
+
+    // errors are passed on
+    if (value_type(lhs) == NumericValue::ERROR ||
+        value_type(rhs) == NumericValue::ERROR)
+        type = NumericValue::ERROR;
+
+    // arrays stay arrays
+    else if (op == RANGE ||
+        value_type(lhs) == NumericValue::ARRAY ||
+        value_type(rhs) == NumericValue::ARRAY)
+        type = NumericValue::ARRAY;
+
+    // division allways produces a floating type
+    else if (op == DIVIDE)
+        type = NumericValue::FLOATING;
+
+    // all other operators only stay exact if both operands are exact
+    else if (value_type(lhs) == NumericValue::EXACT &&
+        value_type(rhs) == NumericValue::EXACT)
+        type = NumericValue::EXACT;
+    else
+        type = NumericValue::FLOATING;
+
+    return add_node(op, type, lhs, rhs);
+}
+
+ExpressionStore::index_t ExpressionStore::add_array(index_t first,
+    index_t count)
+{
+    // an erroneous item only shows up when the array is evaluated
+    return add_node(ARRAY, NumericValue::ARRAY, first, count);
+}
+
+ExpressionStore::index_t ExpressionStore::add_expression(
+    const Expression& expr)
+{
+    if (const NumericExpression* num =
+            dynamic_cast<const NumericExpression*>(&expr))
+        return add_number(num->_val);
+
+    if (const UnaryOperation* unary =
+            dynamic_cast<const UnaryOperation*>(&expr))
+        return add_unary(NEGATION, add_expression(*unary->operand()));
+
+    const BinaryOperation& binary = dynamic_cast<const BinaryOperation&>(expr);
+
+    opcode_t op = PLUS;
+    while (binary_operations[op] != binary.expr_operator())
+        op = static_cast<opcode_t>(op + 1);
+
+    // children first, so the tree stays in post-order
+    index_t lhs = add_expression(*binary.lhs());
+    index_t rhs = add_expression(*binary.rhs());
+
+    return add_binary(op, lhs, rhs);
+}
+
+NumericValue ExpressionStore::numeric_value(index_t root) const
+{
+    if (fusable(root))
+        return fused_value(root);
+
+    return sweep(root);
+}
+
+NumericValue ExpressionStore::sweep(index_t root) const
+{
+    // the leftmost leaf is the first node of the tree
+    index_t first = root;
+    while (opcode(first) != NUMBER)
+        first = _lhs[first];
+
+    // In post-order, every operation finds the values of its operands on top
+    // of the stack.
+    std::vector<NumericValue> stack;
+
+    for (index_t node = first; node <= root; ++node)
+    {
+        switch (opcode(node))
+        {
+            case NUMBER:
+                stack.push_back(number(node));
+                break;
+
+            case NEGATION:
+                stack.back() = negation_op(stack.back());
+                break;
+
+            // the items are the topmost values
+            case ARRAY:
+            {
+                std::size_t items = stack.size() - _rhs[node];
+                NumericValue val = array_op(&stack[items], _rhs[node]);
+
+                stack.resize(items);
+                stack.push_back(val);
+                break;
+            }
+
+            default:
+            {
+                NumericValue rhs = stack.back();
+                stack.pop_back();
+
+                stack.back() = binary_operations[opcode(node)](stack.back(), rhs);
+                break;
+            }
+        }
+    }
+
+    return stack.back();
+}
+
+NumericValue ExpressionStore::fused_value(index_t root) const
+{
+    // Collect the fusable operations below root in post-order, everything
+    // else is an operand and evaluated on its own. Visiting root, rhs and
+    // lhs, in this order, gives the reversed post-order.
+    std::vector<FusedStep> steps;
+    std::vector<index_t> operand_nodes;
+    std::vector<index_t> pending(1, root);
+
+    while (!pending.empty())
+    {
+        index_t node = pending.back();
+        pending.pop_back();
+
+        FusedStep step;
+        step.op = NUMBER;
+        step.operand = 0;
+
+        if (fusable(node))
+        {
+            step.op = opcode(node);
+
+            pending.push_back(_lhs[node]);
+            if (step.op != NEGATION)
+                pending.push_back(_rhs[node]);
+        }
+        else
+            operand_nodes.push_back(node);
+
+        steps.push_back(step);
+    }
+
+    std::reverse(steps.begin(), steps.end());
+    std::reverse(operand_nodes.begin(), operand_nodes.end());
+
+    std::vector<NumericValue> operands;
+    operands.reserve(operand_nodes.size());
+
+    // evaluate the operands, find the number of elements and the types
+    bool fuse = true, sized = false;
+    std::size_t count = 0, operations = 0;
+    std::vector<NumericValue::value_type_t> types;
+
+    for (std::size_t i = 0; i < steps.size(); ++i)
+    {
+        FusedStep& step = steps[i];
+
+        if (step.op == NUMBER)
+        {
+            step.operand = operands.size();
+            operands.push_back(numeric_value(operand_nodes[step.operand]));
+
+            const NumericValue& val = operands.back();
+            if (val.value_type == NumericValue::ERROR)
+            {
+                fuse = false;
+                step.type = NumericValue::ERROR;
+            }
+            else if (val.value_type == NumericValue::ARRAY)
+            {
+                // all arrays need the size of the first one
+                if (!sized)
+                    count = val.value.array->size();
+                else if (val.value.array->size() != count)
+                    fuse = false;
+
+                sized = true;
+                step.type = val.value.array->element_type;
+            }
+            else
+                step.type = val.value_type;
+
+            types.push_back(step.type);
+        }
+        else if (step.op == NEGATION)
+        {
+            step.type = types.back();
+            ++operations;
+        }
+        else
+        {
+            NumericValue::value_type_t rhs = types.back();
+            types.pop_back();
+
+            step.type = types.back() = elementwise_type(
+                static_cast<elementwise_op_t>(step.op - PLUS),
+                types.back(), rhs);
+            ++operations;
+        }
+    }
+
+    // Operations on small arrays, errors and arrays of different sizes are
+    // left to the operator functions. If any element is an error, the
+    // operator functions find out which.
+    if (fuse && operations > 1 && count >= fusion_threshold)
+    {
+        NumericArray* result =
+            NumericArray::create(steps.back().type, count);
+
+        if (run_fused(steps, operands, *result))
+        {
+            NumericValue val;
+            val.value.array = result;
+            val.value_type = NumericValue::ARRAY;
+
+            return val;
+        }
+    }
+
+    return run_unfused(steps, operands);
+}
+
+std::size_t ExpressionStore::memory_usage() const
+{
+    return _opcodes.capacity() * sizeof(uint8_t) +
+        _types.capacity() * sizeof(uint8_t) +
+        _lhs.capacity() * sizeof(index_t) +
+        _rhs.capacity() * sizeof(index_t) +
+        _values.capacity() * sizeof(NumericValue::value_t);
+}
+
+void ExpressionStore::clear()
+{
+    _opcodes.clear();
+    _types.clear();
+    _lhs.clear();
+    _rhs.clear();
+    _values.clear();
+}
@@ -0,0 +1,173 @@
+// expression_store.hpp
+
+/*
+ *   scalc - A simple calculator
+ *   Copyright (C) 2010  Alexander Korsunsky
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EXPRESSION_STORE_HPP_
+#define EXPRESSION_STORE_HPP_
+
+#include <vector>
+#include <cstddef>
+
+#include <stdint.h>
+
+#include "semantic.hpp"
+
+/** Compact storage for expression trees.
+*
+* Nodes are kept in parallel arrays instead of separately allocated objects:
+* a one byte opcode, a one byte value type tag and two 32 bit child indices
+* per node. The values of numbers are kept in a separate column, the first
+* child index of a number node is its index into this column. A node takes
+* 10 bytes, plus 8 bytes for the value of a number.
+*
+* Nodes have to be added in post-order, children before their parents, as
+* the parser creates them. The nodes of a tree then form a contiguous range
+* ending with its root, which lets numeric_value() evaluate a tree in a
+* single sweep over that range, without recursion.
+*
+* Arithmetic on arrays is evaluated differently: consecutive operations on
+* arrays are fused, so that each chunk of elements passes through all of
+* them before the next one is computed, instead of creating an intermediate
+* array for every operation.
+*/
+class ExpressionStore
+{
+public:
+    typedef uint32_t index_t;
+
+    enum opcode_t {
+        NUMBER,
+        NEGATION,
+        PLUS,
+        MINUS,
+        MULTIPLY,
+        DIVIDE,
+        POW,
+        ARRAY,
+        RANGE
+    };
+
+    /** Add a number.
+    * @param val The value of the number
+    * @return The index of the new node
+    */
+    index_t add_number(const NumericValue& val);
+
+    /** Add a unary operation.
+    * @param op The operation, only NEGATION is unary
+    * @param operand The index of the operand node
+    * @return The index of the new node
+    */
+    index_t add_unary(opcode_t op, index_t operand);
+
+    /** Add a binary operation.
+    * @param op The operation
+    * @param lhs The index of the left hand side node
+    * @param rhs The index of the right hand side node
+    * @return The index of the new node
+    */
+    index_t add_binary(opcode_t op, index_t lhs, index_t rhs);
+
+    /** Add an array literal.
+    * The items are the trees directly preceding the new node. The first
+    * child index of the node is the root of the first item, so that the
+    * whole literal forms a contiguous range like any other tree, and the
+    * second is the number of items.
+    * @param first The index of the root node of the first item
+    * @param count The number of items
+    * @return The index of the new node
+    */
+    index_t add_array(index_t first, index_t count);
+
+    /** Copy an expression tree into the store.
+    * @param expr The root of the tree
+    * @return The index of the new root node
+    */
+    index_t add_expression(const Expression& expr);
+
+    /** Evaluate a tree.
+    * @param root The index of the root node of the tree
+    * @return The value of the tree, the same the operator functions would
+    * produce
+    */
+    NumericValue numeric_value(index_t root) const;
+
+    opcode_t opcode(index_t node) const
+    { return static_cast<opcode_t>(_opcodes[node]); }
+
+    /** Return the type of the value a node evaluates to.
+    * For operations this follows the conversion rules of the operator
+    * functions. ERROR means an operand is an erroneous number, ARRAY that the
+    * node evaluates to an array.
+    */
+    NumericValue::value_type_t value_type(index_t node) const
+    { return static_cast<NumericValue::value_type_t>(_types[node]); }
+
+    index_t lhs(index_t node) const
+    { return _lhs[node]; }
+
+    index_t rhs(index_t node) const
+    { return _rhs[node]; }
+
+    /** Return the value of a number node */
+    NumericValue number(index_t node) const
+    {
+        NumericValue val;
+        val.value = _values[_lhs[node]];
+        val.value_type = value_type(node);
+
+        return val;
+    }
+
+    /** Return the number of nodes */
+    std::size_t size() const
+    { return _opcodes.size(); }
+
+    /** Return the number of bytes allocated for the nodes */
+    std::size_t memory_usage() const;
+
+    /** Remove all nodes. Allocated memory is kept for reuse. */
+    void clear();
+
+private:
+    // evaluate a tree one node after another
+    NumericValue sweep(index_t root) const;
+
+    // evaluate arithmetic on arrays element by element
+    NumericValue fused_value(index_t root) const;
+
+    // checks if a node is an arithmetic operation on arrays
+    bool fusable(index_t node) const
+    {
+        return value_type(node) == NumericValue::ARRAY &&
+            opcode(node) >= NEGATION && opcode(node) <= POW;
+    }
+
+    index_t add_node(opcode_t op, NumericValue::value_type_t type,
+        index_t lhs, index_t rhs);
+
+    std::vector<uint8_t> _opcodes;
+    std::vector<uint8_t> _types;
+    std::vector<index_t> _lhs;
+    std::vector<index_t> _rhs;
+
+    std::vector<NumericValue::value_t> _values;
+};
+
+#endif // ifndef EXPRESSION_STORE_HPP_
@@ -0,0 +1,486 @@
+// jit.cpp
+
+/*
+ *   scalc - A simple calculator
+ *   Copyright (C) 2010  Alexander Korsunsky
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if defined(_WIN64)
+#   error "The JIT compiler only supports the System V calling convention"
+#elif !defined(__x86_64__)
+#   error "The JIT compiler can only generate x86-64 code"
+#endif
+
+#include <vector>
+#include <cstring>
+
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include "jit.hpp"
+
+namespace {
+
+typedef NumericValue::value_type_t value_type_t;
+
+// x86-64 register numbers, as used in the ModRM and REX encoding
+enum {
+    RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+    R8 = 8, R9 = 9, R10 = 10, R11 = 11
+};
+
+// Evaluation slots. Slot i holds an EXACT value in gpr_slots[i] or a FLOATING
+// value in xmm register i. Only caller-saved registers are used, so the
+// generated code does not need a prologue. R11 is kept as scratch register.
+const unsigned NUM_SLOTS = 8;
+const unsigned char gpr_slots[NUM_SLOTS] = {
+    RAX, RCX, RDX, RSI, RDI, R8, R9, R10
+};
+
+typedef long (*exact_function_t)();
+typedef double (*floating_function_t)();
+
+
+typedef ExpressionStore::index_t index_t;
+
+// Called from generated code for nodes the code generator does not cover.
+// The generated code has no unwind information, so exceptions must not pass
+// through it. They are reported as failure instead, the tree evaluator then
+// runs again outside of the generated code.
+long fallback_exact(const ExpressionStore* store, index_t node, bool* failed)
+{
+    try {
+        NumericValue val = store->numeric_value(node);
+        if (val.value_type != NumericValue::EXACT)
+            *failed = true;
+
+        return val.value.exact;
+    }
+    catch (...)
+    {
+        *failed = true;
+        return 0;
+    }
+}
+
+double fallback_floating(const ExpressionStore* store, index_t node,
+    bool* failed)
+{
+    try {
+        NumericValue val = store->numeric_value(node);
+        if (val.value_type != NumericValue::FLOATING)
+            *failed = true;
+
+        return val.value.floating;
+    }
+    catch (...)
+    {
+        *failed = true;
+        return 0.;
+    }
+}
+
+
+class CodeGenerator
+{
+    std::vector<unsigned char> _code;
+
+    const ExpressionStore& _store;
+
+    // flag the generated code sets when an error occured
+    bool* _failed;
+
+    // type of the value currently held by each slot
+    value_type_t _slot_types[NUM_SLOTS];
+
+    void byte(unsigned char b)
+    { _code.push_back(b); }
+
+    void imm64(uint64_t v)
+    {
+        for (unsigned i = 0; i < 8; ++i)
+            byte(static_cast<unsigned char>(v >> (8*i)));
+    }
+
+    // emit a register-register instruction: [prefix] [REX] [0F] opcode ModRM
+    void emit_rr(unsigned char prefix, bool wide, bool escape,
+        unsigned char opcode, unsigned reg, unsigned rm)
+    {
+        if (prefix)
+            byte(prefix);
+
+        unsigned char rex = 0x40 | (wide ? 0x08 : 0) |
+            ((reg & 8) ? 0x04 : 0) | ((rm & 8) ? 0x01 : 0);
+        if (rex != 0x40)
+            byte(rex);
+
+        if (escape)
+            byte(0x0F);
+
+        byte(opcode);
+        byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+    }
+
+    void mov_imm64(unsigned reg, uint64_t v)
+    {
+        byte(0x48 | ((reg & 8) ? 0x01 : 0));
+        byte(0xB8 + (reg & 7));
+        imm64(v);
+    }
+
+    void push(unsigned reg)
+    {
+        if (reg & 8)
+            byte(0x41);
+        byte(0x50 + (reg & 7));
+    }
+
+    void pop(unsigned reg)
+    {
+        if (reg & 8)
+            byte(0x41);
+        byte(0x58 + (reg & 7));
+    }
+
+    // set the error flag, unless the condition code cc (0x70 + cc is the
+    // short jump opcode) is met
+    void set_failed_unless(unsigned char cc)
+    {
+        byte(0x70 + cc);
+        byte(0);
+        std::size_t jump_end = _code.size();
+
+        // mov r11, &failed; mov byte [r11], 1
+        mov_imm64(R11, reinterpret_cast<uint64_t>(_failed));
+        byte(0x41); byte(0xC6); byte(0x03); byte(0x01);
+
+        _code[jump_end - 1] = static_cast<unsigned char>(_code.size() - jump_end);
+    }
+
+    // flag signed overflow of the last integer operation
+    void check_overflow()
+    { set_failed_unless(0x1); }     // jno
+
+    // flag a FLOATING result that is not finite, i.e. an exponent with all
+    // bits set
+    void check_finite(unsigned slot)
+    {
+        emit_rr(0x66, true, true, 0x7E, slot, R11);         // movq r11, xmm
+        emit_rr(0, true, false, 0xD1, 4, R11);              // shl r11, 1
+        emit_rr(0, true, false, 0xC1, 5, R11); byte(53);    // shr r11, 53
+        emit_rr(0, true, false, 0x81, 7, R11);              // cmp r11, 0x7FF
+        byte(0xFF); byte(0x07); byte(0x00); byte(0x00);
+        set_failed_unless(0x5);     // jne
+    }
+
+    // convert the EXACT value in a slot to FLOATING
+    void to_floating(unsigned slot)
+    {
+        if (_slot_types[slot] == NumericValue::FLOATING)
+            return;
+
+        // cvtsi2sd xmm, r64
+        emit_rr(0xF2, true, true, 0x2A, slot, gpr_slots[slot]);
+        _slot_types[slot] = NumericValue::FLOATING;
+    }
+
+    void gen_constant(const NumericValue& val, unsigned slot);
+    void gen_negation(index_t node, unsigned slot);
+    void gen_binary(index_t node, unsigned slot);
+    void gen_fallback(index_t node, unsigned slot);
+
+public:
+    CodeGenerator(const ExpressionStore& store, bool* failed)
+        : _store(store), _failed(failed)
+    { }
+
+    // evaluate a node and place the result in slot
+    void gen(index_t node, unsigned slot);
+
+    // emit the return sequence, the result is in slot 0 (rax or xmm0)
+    void ret()
+    { byte(0xC3); }
+
+    const std::vector<unsigned char>& code() const
+    { return _code; }
+};
+
+void CodeGenerator::gen(index_t node, unsigned slot)
+{
+    // erroneous trees are left to the tree evaluator
+    if (_store.value_type(node) == NumericValue::ERROR)
+    {
+        gen_fallback(node, slot);
+        return;
+    }
+
+    switch (_store.opcode(node))
+    {
+        case ExpressionStore::NUMBER:
+            gen_constant(_store.number(node), slot);
+            return;
+
+        case ExpressionStore::NEGATION:
+            gen_negation(node, slot);
+            return;
+
+        case ExpressionStore::PLUS:
+        case ExpressionStore::MINUS:
+        case ExpressionStore::MULTIPLY:
+        case ExpressionStore::DIVIDE:
+            // binary operations need a second slot for the right hand side
+            if (slot + 1 < NUM_SLOTS)
+            {
+                gen_binary(node, slot);
+                return;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    gen_fallback(node, slot);
+}
+
+void CodeGenerator::gen_constant(const NumericValue& val, unsigned slot)
+{
+    if (val.value_type == NumericValue::EXACT)
+    {
+        mov_imm64(gpr_slots[slot], static_cast<uint64_t>(val.value.exact));
+    }
+    else
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &val.value.floating, sizeof(bits));
+
+        // mov r11, imm64; movq xmm, r11
+        mov_imm64(R11, bits);
+        emit_rr(0x66, true, true, 0x6E, slot, R11);
+    }
+
+    _slot_types[slot] = val.value_type;
+}
+
+void CodeGenerator::gen_negation(index_t node, unsigned slot)
+{
+    gen(_store.lhs(node), slot);
+
+    if (_slot_types[slot] == NumericValue::EXACT)
+    {
+        // neg r64
+        emit_rr(0, true, false, 0xF7, 3, gpr_slots[slot]);
+        check_overflow();
+    }
+    else
+    {
+        // flip the sign bit: movq r11, xmm; btc r11, 63; movq xmm, r11
+        emit_rr(0x66, true, true, 0x7E, slot, R11);
+        emit_rr(0, true, true, 0xBA, 7, R11);
+        byte(63);
+        emit_rr(0x66, true, true, 0x6E, slot, R11);
+    }
+}
+
+void CodeGenerator::gen_binary(index_t node, unsigned slot)
+{
+    ExpressionStore::opcode_t op = _store.opcode(node);
+
+    gen(_store.lhs(node), slot);
+    gen(_store.rhs(node), slot + 1);
+
+    // integer operations if both operands are exact and we are not dividing
+    if (op != ExpressionStore::DIVIDE &&
+        _slot_types[slot] == NumericValue::EXACT &&
+        _slot_types[slot + 1] == NumericValue::EXACT)
+    {
+        unsigned dst = gpr_slots[slot], src = gpr_slots[slot + 1];
+
+        if (op == ExpressionStore::PLUS)
+            emit_rr(0, true, false, 0x01, src, dst);        // add
+        else if (op == ExpressionStore::MINUS)
+            emit_rr(0, true, false, 0x29, src, dst);        // sub
+        else
+            emit_rr(0, true, true, 0xAF, dst, src);         // imul
+
+        check_overflow();
+        return;
+    }
+
+    // allways convert to higher order representation if types are different
+    to_floating(slot);
+    to_floating(slot + 1);
+
+    unsigned char opcode;
+    if (op == ExpressionStore::PLUS)
+        opcode = 0x58;      // addsd
+    else if (op == ExpressionStore::MINUS)
+        opcode = 0x5C;      // subsd
+    else if (op == ExpressionStore::MULTIPLY)
+        opcode = 0x59;      // mulsd
+    else
+        opcode = 0x5E;      // divsd
+
+    emit_rr(0xF2, false, true, opcode, slot, slot + 1);
+
+    // operands are finite, so this catches overflows and division by zero
+    check_finite(slot);
+}
+
+void CodeGenerator::gen_fallback(index_t node, unsigned slot)
+{
+    // the value computed in place of an erroneous tree is never used
+    value_type_t type = _store.value_type(node) == NumericValue::EXACT ?
+        NumericValue::EXACT : NumericValue::FLOATING;
+
+    // all slots below this one hold live values, save them on the stack
+    for (unsigned i = 0; i < slot; ++i)
+    {
+        if (_slot_types[i] == NumericValue::EXACT)
+        {
+            push(gpr_slots[i]);
+        }
+        else
+        {
+            emit_rr(0x66, true, true, 0x7E, i, R11);    // movq r11, xmm
+            push(R11);
+        }
+    }
+
+    // The stack is misaligned by 8 bytes on entry. Keep it 16 byte aligned
+    // for the call.
+    bool pad = (slot % 2 == 0);
+    if (pad)
+    {
+        byte(0x48); byte(0x83); byte(0xEC); byte(0x08);  // sub rsp, 8
+    }
+
+    mov_imm64(RDI, reinterpret_cast<uint64_t>(&_store));
+    mov_imm64(RSI, node);
+    mov_imm64(RDX, reinterpret_cast<uint64_t>(_failed));
+    if (type == NumericValue::EXACT)
+        mov_imm64(R11, reinterpret_cast<uint64_t>(&fallback_exact));
+    else
+        mov_imm64(R11, reinterpret_cast<uint64_t>(&fallback_floating));
+    emit_rr(0, false, false, 0xFF, 2, R11);     // call r11
+
+    if (pad)
+    {
+        byte(0x48); byte(0x83); byte(0xC4); byte(0x08);  // add rsp, 8
+    }
+
+    // move the result from rax or xmm0 into its slot
+    if (slot != 0)
+    {
+        if (type == NumericValue::EXACT)
+            emit_rr(0, true, false, 0x89, RAX, gpr_slots[slot]);   // mov
+        else
+            emit_rr(0xF2, false, true, 0x10, slot, 0);             // movsd
+    }
+    _slot_types[slot] = type;
+
+    // restore the saved slots
+    for (unsigned i = slot; i-- > 0; )
+    {
+        if (_slot_types[i] == NumericValue::EXACT)
+        {
+            pop(gpr_slots[i]);
+        }
+        else
+        {
+            pop(R11);
+            emit_rr(0x66, true, true, 0x6E, i, R11);    // movq xmm, r11
+        }
+    }
+}
+
+} // anonymous namespace
+
+
+CompiledExpression::CompiledExpression(const ExpressionStore& store,
+    ExpressionStore::index_t root)
+    : _store(store), _root(root), _code(NULL), _size(0), _failed(false)
+{ }
+
+CompiledExpression* CompiledExpression::compile(const ExpressionStore& store,
+    ExpressionStore::index_t root)
+{
+    // registers only hold numbers, arrays are evaluated by the store
+    if (store.value_type(root) == NumericValue::ARRAY)
+        return NULL;
+
+    // the generated code refers to the error flag of the compiled expression
+    CompiledExpression* compiled = new CompiledExpression(store, root);
+
+    CodeGenerator generator(store, &compiled->_failed);
+    generator.gen(root, 0);
+    generator.ret();
+
+    const std::vector<unsigned char>& code = generator.code();
+
+    void* mem = mmap(NULL, code.size(), PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+    {
+        delete compiled;
+        return NULL;
+    }
+
+    std::memcpy(mem, &code[0], code.size());
+
+    // never keep the region writable and executable at the same time
+    if (mprotect(mem, code.size(), PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(mem, code.size());
+        delete compiled;
+        return NULL;
+    }
+
+    compiled->_code = mem;
+    compiled->_size = code.size();
+
+    return compiled;
+}
+
+NumericValue CompiledExpression::numeric_value() const
+{
+    NumericValue retval;
+
+    _failed = false;
+
+    if (_store.value_type(_root) == NumericValue::EXACT)
+    {
+        retval.value.exact = reinterpret_cast<exact_function_t>(_code)();
+        retval.value_type = NumericValue::EXACT;
+    }
+    else
+    {
+        retval.value.floating = reinterpret_cast<floating_function_t>(_code)();
+        retval.value_type = NumericValue::FLOATING;
+    }
+
+    // let the tree evaluator find out what went wrong
+    if (_failed)
+        return _store.numeric_value(_root);
+
+    return retval;
+}
+
+CompiledExpression::~CompiledExpression()
+{
+    if (_code)
+        munmap(_code, _size);
+}
@@ -0,0 +1,87 @@
+// jit.hpp
+
+/*
+ *   scalc - A simple calculator
+ *   Copyright (C) 2010  Alexander Korsunsky
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JIT_HPP_
+#define JIT_HPP_
+
+#include <cstddef>
+
+#include "expression_store.hpp"
+
+/** Natively compiled expression.
+*
+* An expression tree lowered to x86-64 machine code. EXACT values are kept in
+* general purpose registers, FLOATING values in SSE2 registers. Operations the
+* code generator does not cover (currently POW) and subtrees that would need
+* more registers than available are evaluated by calling back into the tree
+* evaluator, so the result is always the same as the one of the original
+* tree.
+*
+* The generated code only detects that an error occured (integer overflow,
+* a result that is not finite or an error from the tree evaluator). In that
+* case the tree is evaluated again to obtain the error value.
+*
+* The compiled expression refers to the tree in the store, the store has to
+* outlive it.
+*
+* Every statement is compiled, run once and thrown away, so the time for
+* obtaining executable memory is never amortized and -j is slower than the
+* tree evaluator. It is meant for cross-checking the code generator against
+* the tree evaluator, not for speed.
+*/
+struct CompiledExpression
+{
+    /** Compile an expression tree.
+    *
+    * @param store The store containing the tree
+    * @param root The index of the root node of the tree
+    * @return A new compiled expression or NULL if the tree evaluates to an
+    * array or no executable memory could be obtained. The caller takes
+    * ownership of the returned object.
+    */
+    static CompiledExpression* compile(const ExpressionStore& store,
+        ExpressionStore::index_t root);
+
+    /** Run the compiled code.
+    * @return The value of the tree
+    */
+    NumericValue numeric_value() const;
+
+    ~CompiledExpression();
+
+private:
+    CompiledExpression(const ExpressionStore& store,
+        ExpressionStore::index_t root);
+
+    // noncopyable, we own the code region
+    CompiledExpression(const CompiledExpression&);
+    CompiledExpression& operator=(const CompiledExpression&);
+
+    const ExpressionStore& _store;
+    ExpressionStore::index_t _root;
+
+    void* _code;
+    std::size_t _size;
+
+    // set by the generated code if an error occured
+    mutable bool _failed;
+};
+
+#endif // ifndef JIT_HPP_
@@ -21,164 +21,114 @@
 #ifndef PARSING_HPP_
 #define PARSING_HPP_
 
-#include <vector>
-#include <algorithm>
+#include <string>
+#include <ostream>
+#include <cstdio>
+#include <cstddef>
 
 
-template <typename IteratorT>
-void delete_all (IteratorT first, IteratorT last)
-{
-    // iterator is copied by value, so we can use the argument to iterate through the container
-    for ( ; first < last ; first++)
-    {
-        delete *first;
-        *first = NULL;
-    }
-}
-
-
-/** Memory handler class for a specific type.
-*
-* This class stores pointers to objects of a specific type on the heap.  <br>
-* The pointers can be added using registerNew() and removed using unregister().
-* <br>
-* You can also delete a registered pointer using registeredDelete(). <br>
-* To delete all pointers of a type use deleteAll.  <br>
-* @note All pointers passed to the member functions can be NULL. In this case no
-* error occurs, but no action is performed.
-*
-* @tparam T The type of the data the pointers will point to
+/** Buffered error reporting.
 *
+* Error messages are collected in a buffer and written to the output stream
+* in batches, instead of flushing the stream for every error. The buffer is
+* written when it grows larger than BUFSIZ, when flush() is called and on
+* destruction.
 */
-template <typename T>
-class RegisteredPtrs {
-    /** all registered pointers for a type */
-    std::vector<T*> currentlyRegistered;
+class Diagnostics {
+    std::ostream& _os;
+    std::string _buffer;
 
-public:
+    unsigned _error_count;
+    unsigned _max_errors;
 
-    /** Register a pointer.
-    *
-    * Put a pointer into the internal pointer Container.
-    * If ptr is NULL, it is not added to the container.
-    *
-    * @param ptr The pointer that shall be added
-    * @return The pointer given as argument
-    * @post If the pointer was not null, it is now present in the internal
-    * pointer container
-    */
-    T* registerNew(T* ptr);
-
-    /** Registered delete.
-    * Delete a pointer, set to NULL and if present in the pointer container,
-    * remove it from there.
-    *
-    * @param ptr A reference to a pointer that you want to be deleted and
-    * removed from the container
-    *
-    * @note The pointer is deleted in any case, wether or not the pointer is
-    * present in the container
-    *
-    * @post If the pointer is not NULL, it is deleted.
-    * @post If the pointer was present in the internal pointer Container,
-    * it is removed.
-    */
-    void registeredDelete(T*& ptr);
-
-    /** Unregister the pointer.
-    *
-    * The internal pointer container will be searched for the pointer.
-    * If present, it will be removed from there.
-    *
-    * @param ptr The pointer that shall be removed from the internal
-    * pointer container
-    * @return The pointer given as argument
-    *
-    * @post The pointer is not present in the internal pointer container
-    */
-    T* unregister(T* ptr);
-
-    /** delete all registered pointers
-    * Iterates through the list of pointers present in the internal pointer
-    * container and deletes them from memory, clears the internal pointer
-    * container
-    *
-    * @post All pointers contained in the internal pointer container are deleted,
-    * @post the internal pointer container is now empty.
+public:
+    /** Constructor.
+    * @param os The stream the messages will be written to
+    * @param max_errors The number of errors after which limit_reached()
+    * returns true, 0 for no limit
     */
-    void deleteAll();
+    Diagnostics(std::ostream& os, unsigned max_errors = 0)
+        : _os(os), _error_count(0), _max_errors(max_errors)
+    { }
 
-    /** Destrcutor.
-    * Calls deleteAll().
+    /** Report an error.
+    * @param message The error message
+    * @param line The line of the input the error occured in
     */
-    ~RegisteredPtrs()
+    void error(const char* message, int line)
     {
-        deleteAll();
-    }
-};
+        char linebuf[32];
+        sprintf(linebuf, ". line %d\n", line);
 
-template <typename T>
-T* RegisteredPtrs<T>::registerNew(T* ptr)
-{
-    // only add if ptr is not NULL
-    if ( ptr != NULL )
-        currentlyRegistered.push_back(ptr);
-
-    return ptr;
-}
-
-template <typename T>
-void RegisteredPtrs<T>::registeredDelete(T*& ptr)
-{
-    // dont bother if NULL
-    if (ptr == NULL)
-        return;
+        _buffer += message;
+        _buffer += linebuf;
+        ++_error_count;
 
-    // delete and set to NULL in any case
-    delete ptr;
-
-    // unregister pointer
-    unregister(ptr);
+        if (_buffer.size() > BUFSIZ)
+            flush();
+    }
 
-    ptr = NULL;
-}
+    /** Add a message that is not counted as error. */
+    void note(const char* message)
+    {
+        _buffer += message;
+        _buffer += '\n';
+    }
 
-template <typename T>
-T* RegisteredPtrs<T>::unregister(T* ptr)
-{
-    typename std::vector<T*>::iterator it;
+    /** Write all buffered messages to the output stream. */
+    void flush()
+    {
+        if (_buffer.empty())
+            return;
 
-    // find the pointer in the vector
-    it = std::find(currentlyRegistered.begin(), currentlyRegistered.end(),
-                    ptr);
+        _os.write(_buffer.data(), _buffer.size());
+        _os.flush();
+        _buffer.clear();
+    }
 
-    // erase element from the vector if found
-    if ( it != currentlyRegistered.end() )
-        currentlyRegistered.erase(it);
+    unsigned error_count() const
+    { return _error_count; }
 
-    return ptr;
-}
+    /** Check if the maximum number of errors was reported */
+    bool limit_reached() const
+    { return _max_errors != 0 && _error_count >= _max_errors; }
 
-template <typename T>
-void RegisteredPtrs<T>::deleteAll()
-{
-    delete_all (currentlyRegistered.begin(), currentlyRegistered.begin());
-    currentlyRegistered.clear();
-}
+    /** Destructor.
+    * Calls flush().
+    */
+    ~Diagnostics()
+    {
+        flush();
+    }
+};
 
 struct ParserOptions
 {
+    // input is not typed by a user, do not prompt
     bool file_input;
+
+    // compile statements to native code before evaluating them
+    bool use_jit;
+
+    // where to report errors
+    Diagnostics* diagnostics;
 };
 
 extern int yyparse(const ParserOptions& parser_options);
+
+/** Parse statements from a string instead of yyin.
+* The string is scanned in place, the scanner changes it temporarily.
+* @param str The statements, each terminated by a newline. The string has to
+* be followed by two NUL characters.
+* @param length The length of str, without the two NUL characters
+* @param parser_options Options for the parser
+* @return The result of yyparse()
+*/
+extern int parse_string(char* str, std::size_t length,
+    const ParserOptions& parser_options);
 extern void do_cleanup();
 extern FILE* yyin;
 
-#define MEMORY_ASSERT(p) \
-if ( (p) == NULL ) \
-    throw std::bad_alloc();
-
 #if defined(YYDEBUG)
     extern int yydebug;
 #endif
@@ -25,14 +25,23 @@
 
 #include "parsing.hpp"
 #include "semantic.hpp"
+#include "expression_store.hpp"
 
+#if defined(SCALC_JIT)
+#   include "jit.hpp"
+#endif
 
 #include "lex.scalc.hpp"
 
 void print_prompt(const ParserOptions& parser_options);
 void yyerror(const ParserOptions& parser_options, const char* s);
+bool print_result(const ParserOptions& parser_options,
+    ExpressionStore::index_t root);
+bool error_limit_reached(const ParserOptions& parser_options);
+void clear_statement();
 
-RegisteredPtrs<Expression> Expression_Ptrs;
+// nodes of the statement that is currently parsed
+ExpressionStore Expression_Store;
 
 %}
 
@@ -43,11 +52,19 @@ RegisteredPtrs<Expression> Expression_Ptrs;
 
 %union
 {
-    Expression *expression_ptr;
+    ExpressionStore::index_t node;
+
+    // the items of an array literal
+    struct {
+        ExpressionStore::index_t first;
+        ExpressionStore::index_t count;
+    } items;
 };
 
-%type <expression_ptr> expression
-%type <expression_ptr> number
+%type <node> expression
+%type <items> array_items
+%type <node> array_item
+%type <node> number
 
 
 
@@ -85,11 +102,24 @@ input:
 statement:
     expression '\n'
     {
-        std::cout<<*$1<<std::endl;
+        bool valid = print_result(parser_options, $1);
+
+        // nothing keeps the tree or its value after it was evaluated
+        clear_statement();
+
+        if (!valid && error_limit_reached(parser_options))
+            YYABORT;
+
         print_prompt(parser_options);
     }
 |   error '\n'
     {
+        // drop the nodes of the partially parsed statement
+        clear_statement();
+
+        if (error_limit_reached(parser_options))
+            YYABORT;
+
         yyerrok;
         print_prompt(parser_options);
     }
@@ -104,155 +134,163 @@ expression:
     number
     { $$ = $1; }
 |   expression '+' expression
-    {
-        // unregister operand Expressions
-        Expression_Ptrs.unregister($1);
-        Expression_Ptrs.unregister($3);
-
-        // allocate new expression with proper operation, return expression
-        $$ = Expression_Ptrs.registerNew(
-            new BinaryOperation(
-                Expression::ptr_t($1),
-                Expression::ptr_t($3),
-                &plus_op
-        ));
-        MEMORY_ASSERT($$);
-    }
+    { $$ = Expression_Store.add_binary(ExpressionStore::PLUS, $1, $3); }
 
 |   expression '-' expression
-    {
-        // unregister operand Expressions
-        Expression_Ptrs.unregister($1);
-        Expression_Ptrs.unregister($3);
-
-        // allocate new expression with proper operation, return expression
-        $$ = Expression_Ptrs.registerNew(
-            new BinaryOperation(
-                Expression::ptr_t($1),
-                Expression::ptr_t($3),
-                &minus_op
-        ));
-        MEMORY_ASSERT($$);
-    }
+    { $$ = Expression_Store.add_binary(ExpressionStore::MINUS, $1, $3); }
 
 |   expression '*' expression
-    {
-        // unregister operand Expressions
-        Expression_Ptrs.unregister($1);
-        Expression_Ptrs.unregister($3);
-
-        // allocate new expression with proper operation, return expression
-        $$ = Expression_Ptrs.registerNew(
-            new BinaryOperation(
-                Expression::ptr_t($1),
-                Expression::ptr_t($3),
-                &multiply_op
-        ));
-        MEMORY_ASSERT($$);
-    }
+    { $$ = Expression_Store.add_binary(ExpressionStore::MULTIPLY, $1, $3); }
 
 |   expression '/' expression
-    {
-        // unregister operand Expressions
-        Expression_Ptrs.unregister($1);
-        Expression_Ptrs.unregister($3);
-
-        // allocate new expression with proper operation, return expression
-        $$ = Expression_Ptrs.registerNew(
-            new BinaryOperation(
-                Expression::ptr_t($1),
-                Expression::ptr_t($3),
-                &divide_op
-        ));
-        MEMORY_ASSERT($$);
-    }
+    { $$ = Expression_Store.add_binary(ExpressionStore::DIVIDE, $1, $3); }
 |   expression '^' expression
-    {
-        // unregister operand Expressions
-        Expression_Ptrs.unregister($1);
-        Expression_Ptrs.unregister($3);
-
-        // allocate new expression with proper operation, return expression
-        $$ = Expression_Ptrs.registerNew(
-            new BinaryOperation(
-                Expression::ptr_t($1),
-                Expression::ptr_t($3),
-                &pow_op
-        ));
-        MEMORY_ASSERT($$);
-    }
+    { $$ = Expression_Store.add_binary(ExpressionStore::POW, $1, $3); }
 
 |   '-' expression  %prec NEGATION
-    {
-        // unregister operand Expressions
-        Expression_Ptrs.unregister($2);
-
-        // allocate new expression with proper operation, return expression
-        $$ = Expression_Ptrs.registerNew(
-            new UnaryOperation(Expression::ptr_t($2), &negation_op)
-        );
-        MEMORY_ASSERT($$);
-    }
+    { $$ = Expression_Store.add_unary(ExpressionStore::NEGATION, $2); }
 
 |   '(' expression ')'
     { $$ = $2; }
+
+|   '[' array_items ']'
+    { $$ = Expression_Store.add_array($2.first, $2.count); }
+;
+
+// The items of an array are separated by commas. They directly follow each
+// other in the store, so only the first one and their number are kept.
+array_items:
+    array_item
+    { $$.first = $1; $$.count = 1; }
+|   array_items ',' array_item
+    { $$ = $1; ++$$.count; }
+;
+
+// an element is a number, an array or a range of numbers
+array_item:
+    expression
+    { $$ = $1; }
+|   expression ':' expression
+    { $$ = Expression_Store.add_binary(ExpressionStore::RANGE, $1, $3); }
 ;
 
 // A number is whatever looks a number
 number:
     UINT
     {
+        // read the number from the string, errors are reported when the
+        // statement is evaluated
         NumericValue val;
+        val.from_exact(yytext);
 
-        try {
-            // try to read the number from the string
-            val.from_exact(yytext);
-        }
-        catch(const NumericError& e)
-        {
-            yyerror(parser_options, (std::string("Error: ")+e.what()).c_str());
-            YYERROR;
-        }
-
-        // create new NumericValueExpression object
-        $$ = Expression_Ptrs.registerNew(new NumericExpression(val));
-        MEMORY_ASSERT($$);
+        $$ = Expression_Store.add_number(val);
     }
 |
     NUMBER
     {
+        // read the number from the string, errors are reported when the
+        // statement is evaluated
         NumericValue val;
+        val.from_floating(yytext);
+
+        $$ = Expression_Store.add_number(val);
+    }
+;
+
+%%
+
+void yyerror(const ParserOptions& parser_options, const char* s)
+{
+    // the scanner already counted the newline if that is the offending token
+    int line = (yychar == '\n') ? yylineno - 1 : yylineno;
+
+    parser_options.diagnostics->error(s, line);
+}
+
+void do_cleanup()
+{
+    clear_statement();
+}
+
+void clear_statement()
+{
+    Expression_Store.clear();
+    NumericArray::release_all();
+}
 
+bool print_result(const ParserOptions& parser_options,
+    ExpressionStore::index_t root)
+{
+    NumericValue val;
+
+#if defined(SCALC_JIT)
+    if (parser_options.use_jit)
+    {
+        CompiledExpression* compiled =
+            CompiledExpression::compile(Expression_Store, root);
+
+        // evaluate the tree directly if we could not compile it
         try {
-            // try to read the number from the string
-            val.from_floating(yytext);
+            if (compiled)
+                val = compiled->numeric_value();
+            else
+                val = Expression_Store.numeric_value(root);
         }
-        catch(const NumericError& e)
+        catch (...)
         {
-            yyerror(parser_options, (std::string("Error: ")+e.what()).c_str());
-            YYERROR;
+            delete compiled;
+            throw;
         }
 
-        // create new NumericValueExpression object
-        $$ = Expression_Ptrs.registerNew(new NumericExpression(val));
-        MEMORY_ASSERT($$);
+        delete compiled;
     }
-;
+    else
+#endif
+        val = Expression_Store.numeric_value(root);
 
-%%
+    if (val.value_type == NumericValue::ERROR)
+    {
+        // the newline ending the statement was already read
+        parser_options.diagnostics->error(
+            (std::string("Error: ")+NumericError::what(val.value.error)).c_str(),
+            yylineno - 1
+        );
+        return false;
+    }
 
-void yyerror(const ParserOptions& parser_options, const char* s)
+    std::cout<<val<<std::endl;
+    return true;
+}
+
+bool error_limit_reached(const ParserOptions& parser_options)
 {
-    std::cerr<<s<<". line "<<yylineno<<std::endl;
+    if (!parser_options.diagnostics->limit_reached())
+        return false;
+
+    parser_options.diagnostics->note("Too many errors, stopping.");
+    return true;
 }
 
-void do_cleanup()
+int parse_string(char* str, std::size_t length,
+    const ParserOptions& parser_options)
 {
-    Expression_Ptrs.deleteAll();
+    // scan the string in place, yyin is never opened and the string is not
+    // copied into a buffer of the scanner
+    YY_BUFFER_STATE buffer = yy_scan_buffer(str, length + 2);
+    if (buffer == NULL)
+        return 1;
+    int result = yyparse(parser_options);
+    yy_delete_buffer(buffer);
+
+    return result;
 }
 
 void print_prompt(const ParserOptions& parser_options)
 {
     if (!parser_options.file_input)
+    {
+        // show errors right away when running interactively
+        parser_options.diagnostics->flush();
         printf("> ");
+    }
 }
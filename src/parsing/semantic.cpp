@@ -18,16 +18,67 @@
  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <cfloat>
+
 #include "semantic.hpp"
+#include "array.hpp"
+
+const char* NumericError::what(errtype_t errtype)
+{
+    switch (errtype)
+    {
+        case ERR_INVALID_FORMAT:
+            return "Invalid number format";
+        case ERR_OVERFLOW:
+            return "Out of numeric range";
+        case ERR_DIVISION_BY_ZERO:
+            return "Division by zero";
+        case ERR_DOMAIN:
+            return "Result is not a real number";
+        case ERR_ARRAY_SIZE:
+            return "Array sizes do not match";
+        case ERR_RANGE:
+            return "Range bounds have to be numbers";
+        default:
+            return "Unknown numeric error";
+    }
+}
+
+namespace {
+
+// Store a floating result. Operands are allways finite, so a result that is
+// not is an overflow.
+inline NumericValue& set_floating(NumericValue& retval, double result)
+{
+    if (!(std::fabs(result) <= DBL_MAX))
+        return retval.set_error(NumericError::ERR_OVERFLOW);
+
+    retval.value.floating = result;
+    retval.value_type = NumericValue::FLOATING;
+
+    return retval;
+}
+
+} // anonymous namespace
+
 
 NumericValue negation_op(const NumericValue& operand)
 {
     NumericValue retval;
 
     if (operand.value_type == NumericValue::EXACT)
+    {
+        if (operand.value.exact == LONG_MIN)
+            return retval.set_error(NumericError::ERR_OVERFLOW);
+
         retval.value.exact = -operand.value.exact;
+    }
     else if(operand.value_type == NumericValue::FLOATING)
         retval.value.floating = -operand.value.floating;
+    else if(operand.value_type == NumericValue::ARRAY)
+        return elementwise_negation(operand);
+    else
+        return operand;
 
     retval.value_type = operand.value_type;
 
@@ -38,32 +89,43 @@ NumericValue plus_op(const NumericValue& lhs, const NumericValue& rhs)
 {
     NumericValue retval;
 
+    // errors are passed on
+    if (lhs.value_type == NumericValue::ERROR)
+        return lhs;
+    if (rhs.value_type == NumericValue::ERROR)
+        return rhs;
+
+    // arrays are combined element by element
+    if (lhs.value_type == NumericValue::ARRAY ||
+        rhs.value_type == NumericValue::ARRAY)
+        return elementwise_op(ELEMENTWISE_PLUS, lhs, rhs);
+
     // simply add values of the same type
     if (lhs.value_type == NumericValue::EXACT &&
         rhs.value_type == NumericValue::EXACT)
     {
+        if (add_overflows(lhs.value.exact, rhs.value.exact))
+            return retval.set_error(NumericError::ERR_OVERFLOW);
+
         retval.value.exact = lhs.value.exact + rhs.value.exact;
         retval.value_type = NumericValue::EXACT;
     }
     else if (lhs.value_type == NumericValue::FLOATING &&
         rhs.value_type == NumericValue::FLOATING)
     {
-        retval.value.floating = lhs.value.floating + rhs.value.floating;
-        retval.value_type = NumericValue::FLOATING;
+        set_floating(retval, lhs.value.floating + rhs.value.floating);
     }
 
     // allways convert to higher order representation if types are different
     else if (lhs.value_type == NumericValue::EXACT &&
         rhs.value_type == NumericValue::FLOATING)
     {
-        retval.value.floating = lhs.value.exact + rhs.value.floating;
-        retval.value_type = NumericValue::FLOATING;
+        set_floating(retval, lhs.value.exact + rhs.value.floating);
     }
     else if (lhs.value_type == NumericValue::FLOATING &&
         rhs.value_type == NumericValue::EXACT)
     {
-        retval.value.floating = lhs.value.floating + rhs.value.exact;
-        retval.value_type = NumericValue::FLOATING;
+        set_floating(retval, lhs.value.floating + rhs.value.exact);
     }
 
     return retval;
@@ -73,32 +135,43 @@ NumericValue minus_op(const NumericValue& lhs, const NumericValue& rhs)
 {
     NumericValue retval;
 
+    // errors are passed on
+    if (lhs.value_type == NumericValue::ERROR)
+        return lhs;
+    if (rhs.value_type == NumericValue::ERROR)
+        return rhs;
+
+    // arrays are combined element by element
+    if (lhs.value_type == NumericValue::ARRAY ||
+        rhs.value_type == NumericValue::ARRAY)
+        return elementwise_op(ELEMENTWISE_MINUS, lhs, rhs);
+
     // simply subtract values of the same type
     if (lhs.value_type == NumericValue::EXACT &&
         rhs.value_type == NumericValue::EXACT)
     {
+        if (sub_overflows(lhs.value.exact, rhs.value.exact))
+            return retval.set_error(NumericError::ERR_OVERFLOW);
+
         retval.value.exact = lhs.value.exact - rhs.value.exact;
         retval.value_type = NumericValue::EXACT;
     }
     else if (lhs.value_type == NumericValue::FLOATING &&
         rhs.value_type == NumericValue::FLOATING)
     {
-        retval.value.floating = lhs.value.floating - rhs.value.floating;
-        retval.value_type = NumericValue::FLOATING;
+        set_floating(retval, lhs.value.floating - rhs.value.floating);
     }
 
     // allways convert to higher order representation if types are different
     else if (lhs.value_type == NumericValue::EXACT &&
         rhs.value_type == NumericValue::FLOATING)
     {
-        retval.value.floating = lhs.value.exact - rhs.value.floating;
-        retval.value_type = NumericValue::FLOATING;
+        set_floating(retval, lhs.value.exact - rhs.value.floating);
     }
     else if (lhs.value_type == NumericValue::FLOATING &&
         rhs.value_type == NumericValue::EXACT)
     {
-        retval.value.floating = lhs.value.floating - rhs.value.exact;
-        retval.value_type = NumericValue::FLOATING;
+        set_floating(retval, lhs.value.floating - rhs.value.exact);
     }
 
     return retval;
@@ -108,32 +181,43 @@ NumericValue multiply_op(const NumericValue& lhs, const NumericValue& rhs)
 {
     NumericValue retval;
 
+    // errors are passed on
+    if (lhs.value_type == NumericValue::ERROR)
+        return lhs;
+    if (rhs.value_type == NumericValue::ERROR)
+        return rhs;
+
+    // arrays are combined element by element
+    if (lhs.value_type == NumericValue::ARRAY ||
+        rhs.value_type == NumericValue::ARRAY)
+        return elementwise_op(ELEMENTWISE_MULTIPLY, lhs, rhs);
+
     // simply multiply values of the same type
     if (lhs.value_type == NumericValue::EXACT &&
         rhs.value_type == NumericValue::EXACT)
     {
+        if (mul_overflows(lhs.value.exact, rhs.value.exact))
+            return retval.set_error(NumericError::ERR_OVERFLOW);
+
         retval.value.exact = lhs.value.exact * rhs.value.exact;
         retval.value_type = NumericValue::EXACT;
     }
     else if (lhs.value_type == NumericValue::FLOATING &&
         rhs.value_type == NumericValue::FLOATING)
     {
-        retval.value.floating = lhs.value.floating * rhs.value.floating;
-        retval.value_type = NumericValue::FLOATING;
+        set_floating(retval, lhs.value.floating * rhs.value.floating);
     }
 
     // allways convert to higher order representation if types are different
     else if (lhs.value_type == NumericValue::EXACT &&
         rhs.value_type == NumericValue::FLOATING)
     {
-        retval.value.floating = lhs.value.exact * rhs.value.floating;
-        retval.value_type = NumericValue::FLOATING;
+        set_floating(retval, lhs.value.exact * rhs.value.floating);
     }
     else if (lhs.value_type == NumericValue::FLOATING &&
         rhs.value_type == NumericValue::EXACT)
     {
-        retval.value.floating = lhs.value.floating * rhs.value.exact;
-        retval.value_type = NumericValue::FLOATING;
+        set_floating(retval, lhs.value.floating * rhs.value.exact);
     }
 
     return retval;
@@ -143,30 +227,44 @@ NumericValue divide_op(const NumericValue& lhs, const NumericValue& rhs)
 {
     NumericValue retval;
 
+    // errors are passed on
+    if (lhs.value_type == NumericValue::ERROR)
+        return lhs;
+    if (rhs.value_type == NumericValue::ERROR)
+        return rhs;
+
+    // arrays are combined element by element
+    if (lhs.value_type == NumericValue::ARRAY ||
+        rhs.value_type == NumericValue::ARRAY)
+        return elementwise_op(ELEMENTWISE_DIVIDE, lhs, rhs);
+
+    if ((rhs.value_type == NumericValue::EXACT && rhs.value.exact == 0) ||
+        (rhs.value_type == NumericValue::FLOATING && rhs.value.floating == 0.))
+        return retval.set_error(NumericError::ERR_DIVISION_BY_ZERO);
+
     // division allways produces a floating type
     if (lhs.value_type == NumericValue::EXACT &&
       rhs.value_type == NumericValue::EXACT)
     {
-        retval.value.floating =
-            static_cast<double>(lhs.value.exact) / rhs.value.exact;
+        set_floating(retval,
+            static_cast<double>(lhs.value.exact) / rhs.value.exact);
     }
     else if (lhs.value_type == NumericValue::FLOATING &&
         rhs.value_type == NumericValue::FLOATING)
     {
-        retval.value.floating = lhs.value.floating / rhs.value.floating;
+        set_floating(retval, lhs.value.floating / rhs.value.floating);
     }
     else if (lhs.value_type == NumericValue::EXACT &&
         rhs.value_type == NumericValue::FLOATING)
     {
-        retval.value.floating = lhs.value.exact / rhs.value.floating;
+        set_floating(retval, lhs.value.exact / rhs.value.floating);
     }
     else if (lhs.value_type == NumericValue::FLOATING &&
         rhs.value_type == NumericValue::EXACT)
     {
-        retval.value.floating = lhs.value.floating / rhs.value.exact;
+        set_floating(retval, lhs.value.floating / rhs.value.exact);
     }
 
-    retval.value_type = NumericValue::FLOATING;
     return retval;
 }
 
@@ -174,35 +272,48 @@ NumericValue pow_op(const NumericValue& lhs, const NumericValue& rhs)
 {
     NumericValue retval;
 
+    // errors are passed on
+    if (lhs.value_type == NumericValue::ERROR)
+        return lhs;
+    if (rhs.value_type == NumericValue::ERROR)
+        return rhs;
+
+    // arrays are combined element by element
+    if (lhs.value_type == NumericValue::ARRAY ||
+        rhs.value_type == NumericValue::ARRAY)
+        return elementwise_op(ELEMENTWISE_POW, lhs, rhs);
+
+    double base = (lhs.value_type == NumericValue::EXACT) ?
+        lhs.value.exact : lhs.value.floating;
+    double exponent = (rhs.value_type == NumericValue::EXACT) ?
+        rhs.value.exact : rhs.value.floating;
+
+    // a negative power of zero is a division by zero
+    if (base == 0. && exponent < 0.)
+        return retval.set_error(NumericError::ERR_DIVISION_BY_ZERO);
+
+    // fractional power of a negative number
+    double result = std::pow(base, exponent);
+    if (result != result)
+        return retval.set_error(NumericError::ERR_DOMAIN);
+
     // exact to the power of an exact is still exact
     if (lhs.value_type == NumericValue::EXACT &&
         rhs.value_type == NumericValue::EXACT)
     {
-        retval.value.exact = std::pow(lhs.value.exact,rhs.value.exact);
+        // the range of long int is [LONG_MIN, -LONG_MIN)
+        if (!(result >= static_cast<double>(LONG_MIN) &&
+              result < -static_cast<double>(LONG_MIN)))
+            return retval.set_error(NumericError::ERR_OVERFLOW);
+
+        retval.value.exact = static_cast<long int>(result);
         retval.value_type = NumericValue::EXACT;
     }
-    // floating pow operation
-    else if (lhs.value_type == NumericValue::FLOATING &&
-        rhs.value_type == NumericValue::FLOATING)
-    {
-        retval.value.floating = std::pow(lhs.value.floating,rhs.value.floating);
-        retval.value_type = NumericValue::FLOATING;
-    }
-
     // convert to floating if exponent or base is floating
-    else if (lhs.value_type == NumericValue::EXACT &&
-        rhs.value_type == NumericValue::FLOATING)
-    {
-        retval.value.floating = std::pow(lhs.value.exact, rhs.value.floating);
-        retval.value_type = NumericValue::FLOATING;
-    }
-    else if (lhs.value_type == NumericValue::FLOATING &&
-        rhs.value_type == NumericValue::EXACT)
+    else
     {
-        retval.value.floating = std::pow(lhs.value.floating, rhs.value.exact);
-        retval.value_type = NumericValue::FLOATING;
+        set_floating(retval, result);
     }
 
     return retval;
 }
-
@@ -22,10 +22,11 @@
 #define SEMANTIC_HPP_
 
 #include <iostream>
-#include <stdexcept>
+#include <vector>
 #include <cstdlib>
 #include <cerrno>
 #include <cmath>
+#include <climits>
 
 #include <memory>
 
@@ -33,76 +34,73 @@
 #   include <tr1/memory>
 #endif
 
-struct NumericError : public std::runtime_error
+/** Errors that can occur while reading or evaluating numbers.
+*
+* Errors are not thrown, they are carried by a NumericValue of type ERROR
+* through the evaluation and reported when the value is used.
+*/
+struct NumericError
 {
     enum errtype_t {
         ERR_INVALID_FORMAT,
         ERR_OVERFLOW,
+        ERR_DIVISION_BY_ZERO,
+        ERR_DOMAIN,
+        ERR_ARRAY_SIZE,
+        ERR_RANGE,
 
         UNKNOWN
-    } _errtype;
-
-public:
-    /** Default Constructor */
-    NumericError() throw()
-        : std::runtime_error("Unknown numeric error"), _errtype(UNKNOWN)
-    { }
-
-    /** Constructor.
-    * @param str The error message
-    */
-    NumericError(const char* str, errtype_t errtype) throw()
-        : std::runtime_error(str), _errtype(errtype)
-    {}
+    };
 
     /** Return error message as char array.
+    * @param errtype The type of the error
     * @return A null- terminated character array containg the error message
     */
-    virtual const char* what() const throw()
-    { return std::runtime_error::what(); }
-
-    virtual ~NumericError() throw() { }
+    static const char* what(errtype_t errtype);
 };
 
 
 
+struct NumericArray;
+
 struct NumericValue
 {
     typedef std::tr1::shared_ptr<NumericValue> ptr_t;
 
     // what type of number is this
-    enum {
+    enum value_type_t {
         EXACT,
-        FLOATING
+        FLOATING,
+        ERROR,
+        ARRAY
     } value_type;
 
-    union {
+    union value_t {
         long int exact;
         double floating;
+        NumericError::errtype_t error;
+        const NumericArray* array;
     } value;
 
+    NumericValue& set_error(NumericError::errtype_t errtype)
+    {
+        value.error = errtype;
+        value_type = ERROR;
+
+        return *this;
+    }
+
     NumericValue& from_exact(const char* str)
-        throw (NumericError)
     {
         char* endptr;
 
+        errno = 0;
         value.exact = strtol(str, &endptr, 10);
         if (endptr == str)
-        {
-            throw(NumericError(
-                    "Invalid integer format",
-                    NumericError::ERR_INVALID_FORMAT
-            ));
-        }
+            return set_error(NumericError::ERR_INVALID_FORMAT);
 
         if (errno == ERANGE)
-        {
-            throw(
-                NumericError(
-                    "Out of numeric range",
-                    NumericError::ERR_OVERFLOW
-            ));
-        }
+            return set_error(NumericError::ERR_OVERFLOW);
 
         value_type = EXACT;
 
@@ -110,27 +108,16 @@ struct NumericValue
     }
 
     NumericValue& from_floating(const char* str)
-        throw (NumericError)
     {
         char* endptr;
 
+        errno = 0;
         value.floating = strtod(str, &endptr);
         if (endptr == str)
-        {
-            throw(NumericError(
-                    "Invalid integer format",
-                    NumericError::ERR_INVALID_FORMAT
-            ));
-        }
+            return set_error(NumericError::ERR_INVALID_FORMAT);
 
         if (errno == ERANGE && value.floating == HUGE_VAL)
-        {
-            throw(
-                NumericError(
-                    "Out of numeric range",
-                    NumericError::ERR_OVERFLOW
-            ));
-        }
+            return set_error(NumericError::ERR_OVERFLOW);
 
         value_type = FLOATING;
 
@@ -140,12 +127,121 @@ struct NumericValue
 };
 
 
+/** Elements of an ARRAY value.
+*
+* All elements have the same type and are stored contiguously, only the
+* vector for the element type is used. Arrays are shared between values and
+* never changed once they are filled.
+*
+* Values only point to their array, so that numbers stay small and cheap to
+* copy. The arrays are kept in a pool instead and live until release_all()
+* is called, which the parser does after every statement. Whoever evaluates
+* expressions that may produce arrays has to release them.
+*/
+struct NumericArray
+{
+    /** Create an array in the pool.
+    * @param type The type of the elements, EXACT or FLOATING
+    * @param size The number of elements
+    * @return The new array, owned by the pool
+    */
+    static NumericArray* create(NumericValue::value_type_t type,
+        std::size_t size);
+
+    /** Delete all arrays in the pool.
+    * Values refering to any of them must not be used afterwards.
+    */
+    static void release_all();
+
+    std::size_t size() const
+    {
+        return element_type == NumericValue::EXACT ?
+            exact.size() : floating.size();
+    }
+
+    /** Return a single element as value */
+    NumericValue element(std::size_t i) const
+    {
+        NumericValue val;
+        if (element_type == NumericValue::EXACT)
+            val.value.exact = exact[i];
+        else
+            val.value.floating = floating[i];
+        val.value_type = element_type;
+
+        return val;
+    }
+
+    NumericValue::value_type_t element_type;
+
+    std::vector<long int> exact;
+    std::vector<double> floating;
+
+private:
+    NumericArray(NumericValue::value_type_t type, std::size_t size)
+        : element_type(type)
+    {
+        if (type == NumericValue::EXACT)
+            exact.resize(size);
+        else
+            floating.resize(size);
+    }
+};
+
 inline std::ostream& operator << (std::ostream& os, const NumericValue& v)
 {
     if (v.value_type == NumericValue::EXACT)
         return os<<v.value.exact;
     else if(v.value_type == NumericValue::FLOATING)
         return os<<v.value.floating;
+    else if(v.value_type == NumericValue::ARRAY)
+    {
+        os<<'[';
+        for (std::size_t i = 0; i < v.value.array->size(); ++i)
+        {
+            if (i != 0)
+                os<<", ";
+            os<<v.value.array->element(i);
+        }
+        return os<<']';
+    }
+    else
+        return os<<"Error: "<<NumericError::what(v.value.error);
+}
+
+// checks if lhs + rhs can be represented as long int
+inline bool add_overflows(long int lhs, long int rhs)
+{
+    return (rhs > 0 && lhs > LONG_MAX - rhs) ||
+        (rhs < 0 && lhs < LONG_MIN - rhs);
+}
+
+// checks if lhs - rhs can be represented as long int
+inline bool sub_overflows(long int lhs, long int rhs)
+{
+    return (rhs < 0 && lhs > LONG_MAX + rhs) ||
+        (rhs > 0 && lhs < LONG_MIN + rhs);
+}
+
+// checks if lhs * rhs can be represented as long int
+inline bool mul_overflows(long int lhs, long int rhs)
+{
+    if (lhs > 0)
+    {
+        if (rhs > 0)
+            return lhs > LONG_MAX / rhs;
+        else
+            return rhs < LONG_MIN / lhs;
+    }
+    else if (lhs < 0)
+    {
+        if (rhs > 0)
+            return lhs < LONG_MIN / rhs;
+        else
+            return rhs != 0 && rhs < LONG_MAX / lhs;
+    }
+
+    return false;
 }
 
 #if 0
@@ -183,7 +279,7 @@ struct NumericExpression : public Expression
     { return _val; }
 
     virtual std::ostream& to_stream(std::ostream& os) const
-    { os<<_val; }
+    { return os<<_val; }
 
     virtual ~NumericExpression() {};
 
@@ -206,11 +302,17 @@ struct UnaryOperation : public Expression
 
     virtual std::ostream& to_stream(std::ostream& os) const
     {
-        os<<numeric_value();
+        return os<<numeric_value();
     }
 
     virtual ~UnaryOperation() {}
 
+    const Expression::ptr_t& operand() const
+    { return _operand; }
+
+    unary_operation_t expr_operator() const
+    { return _expr_operator; }
+
 private:
     Expression::ptr_t _operand;
     unary_operation_t _expr_operator;
@@ -236,11 +338,20 @@ struct BinaryOperation : public Expression
 
     virtual std::ostream& to_stream(std::ostream& os) const
     {
-        os<<numeric_value();
+        return os<<numeric_value();
     }
 
     virtual ~BinaryOperation() {}
 
+    const Expression::ptr_t& lhs() const
+    { return _lhs; }
+
+    const Expression::ptr_t& rhs() const
+    { return _rhs; }
+
+    binary_operation_t expr_operator() const
+    { return _expr_operator; }
+
 private:
     Expression::ptr_t _lhs, _rhs;
     binary_operation_t _expr_operator;
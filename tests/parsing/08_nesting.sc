@@ -0,0 +1,7 @@
+1 + (2 + (3 + (4 + (5 + (6 + (7 + (8 + (9 + (10 + 11)))))))))
+1 - (2 * (3 - (4 * (5 - (6 * (7 - (8 * (9 - (10 * 11)))))))))
+1.5 * (2 + (3.5 * (4 - (5.5 / (6 + (7.5 * (8 - (9.5 / (10 + 11)))))))))
+-(1 + -(2.5 - -(3 * -(4.5))))
+2 * (3 + 2^(1 + 2^(1 + 1)))
+(1 + 2) * (3 + (4 + (5 + (6 + (7 + (8 + (9 + 1^2)))))))
+2^0.5 * -3
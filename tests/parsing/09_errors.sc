@@ -0,0 +1,15 @@
+1 / 0 # division by zero
+2.5 / (1 - 1.0)
+3 + 4
+9223372036854775807 + 1 # overflow of exact numbers
+-9223372036854775807 - 2
+4294967296 * 4294967296
+2^63
+2^62
+1e300 * 1e300 # overflow of floating numbers
+99999999999999999999 # exact literal out of range
+1e400 # floating literal out of range
+(-8)^0.5
+0^-1
+1 + 2 * (3 / 0) - 4
+5 * 5
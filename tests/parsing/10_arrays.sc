@@ -0,0 +1,21 @@
+[1, 2.5, 3]
+[1:5] # a range includes both bounds
+[0.5:3]
+[5:1]
+[1:3, 7, [8, 9]]
+[1, 2, 3] * 2
+[1:4] + [10:13]
+[1, 2] * 2.5 - 1
+-[1:3]
+[1:3] / 2
+2 ^ [0:4]
+[1:3] * [1:3] - [1:3] + 1
+-[0:2047] * 2 + 4094 # large arrays are computed in a single pass
+[1, 2] + [1, 2, 3]
+[1:0] + [1:3000] * 2 # an empty array is still compared by size
+[9223372036854775807, 1] + 1
+[1, 2] / [1, 0]
+[[1, 2]:3]
+(-2) ^ [0.5, 2]
+[0:2999] * 2 + 9223372036854775000
+1 / ([0:2999] * 2 - 10)
@@ -0,0 +1,121 @@
+#!/bin/sh
+
+# Command line testing script
+# Purpose of this script is to check the command line options of scalc that
+# can not be covered by the input files in the testing directories: exit
+# statuses, option values and the output for errors.
+#
+# Usage: ./run-cli-tests.sh <executable>
+#
+# Depends: printf, mktemp
+
+
+# first argument is executable file name
+if [ ! -f "$1" ]; then
+    echo "First argument must be the path to the executable to be tested!"
+    exit 1
+else
+    EXFILE="$1"
+    # if somebody provided the name of the executable without any directories,
+    # prepend './' to be able to execute the file
+    if [ "$EXFILE" = $(basename "$EXFILE") ]; then
+        EXFILE="./$EXFILE"
+    fi
+fi
+
+FAILED=0
+
+# Check the output and the exit status of one run
+#
+# $1: name of the check
+# $2: the input piped to the executable
+# $3: the expected output, stdout followed by stderr
+# $4: the expected exit status
+# remaining arguments are passed to the executable
+check()
+{
+    NAME="$1"
+    INPUT="$2"
+    EXPECTED="$3"
+    EXPECTED_STATUS="$4"
+    shift 4
+
+    printf "Running $NAME... "
+
+    OUTPUT=$(printf "$INPUT" | "$EXFILE" "$@" 2>&1)
+    STATUS=$?
+
+    if [ "$OUTPUT" = "$EXPECTED" ] && [ $STATUS -eq $EXPECTED_STATUS ]
+    then
+        printf '\33[32m passed. \33[0m\n'
+    else
+        printf '\33[31m failed! \33[0m\n'
+        printf 'expected (status %s):\n%s\n' "$EXPECTED_STATUS" "$EXPECTED"
+        printf 'got (status %s):\n%s\n\n' "$STATUS" "$OUTPUT"
+        FAILED=1
+    fi
+}
+
+# a file with one error every other line
+ERRFILE=$(mktemp)
+printf '1/0\n1\n1/0\n2\n1/0\n3\n' > "$ERRFILE"
+
+check max-errors-stops '' \
+"1
+Error: Division by zero. line 1
+Error: Division by zero. line 3
+Too many errors, stopping." \
+    1 --max-errors 2 "$ERRFILE"
+
+check max-errors-not-reached '' \
+"1
+2
+3
+Error: Division by zero. line 1
+Error: Division by zero. line 3
+Error: Division by zero. line 5" \
+    0 --max-errors 4 "$ERRFILE"
+
+check max-errors-zero '' \
+    "--max-errors needs a positive number up to 4294967295" \
+    1 --max-errors 0 "$ERRFILE"
+
+check max-errors-too-large '' \
+    "--max-errors needs a positive number up to 4294967295" \
+    1 --max-errors 4294967296 "$ERRFILE"
+
+check max-errors-missing '' \
+    "--max-errors needs a positive number up to 4294967295" \
+    1 --max-errors
+
+check expression-repeated '' \
+"3
+2.5" \
+    0 -e '1 + 2' -e '5 / 2'
+
+check expression-numeric-error '' \
+"3
+1.5
+Error: Division by zero. line 2" \
+    1 -e '1 + 2' -e '1 / 0' -e 1.5
+
+check expression-syntax-error '' \
+"5
+syntax error, unexpected '\\n'. line 1" \
+    1 -e '1 +' -e 5
+
+check expression-ignores-stdin '7\n' \
+    "2" \
+    0 -e '1 + 1'
+
+check expression-with-file '' \
+    "Can not read an input file when using -e" \
+    1 -e '1 + 1' "$ERRFILE"
+
+check expression-missing '' \
+    "-e needs an expression" \
+    1 -e
+
+rm -f "$ERRFILE"
+
+exit $FAILED
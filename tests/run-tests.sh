@@ -5,11 +5,13 @@
 # directory and compare the stdout of the executable to files containing the
 # expected output
 #
-# Usage: ./run-tests.sh <executable> <testing-directory>
+# Usage: ./run-tests.sh <executable> <testing-directory> [<options>...]
 #
 # This searches <testing-directory> for .sc files, runs the <executable> with
 # all files ending with '.sc' as argument and compares the output to the files
-# ending with '.expected'.
+# ending with '.expected'. Any further <options> are passed to the executable,
+# so the same expected output can be checked against different modes, e.g.
+# '-j' to cross-check compiled expressions against the tree evaluator.
 #
 # Depends: grep, tee, diff
 
@@ -26,7 +28,7 @@ FILEXT='.sc'
 run_test()
 {
     # compare the output of $1 when called with $2.sc to $2.expected
-    "$1" "$2$FILEXT" 2>&1 | tee "$TEMP_OUT_FILE" | \
+    "$1" $EXOPTIONS "$2$FILEXT" 2>&1 | tee "$TEMP_OUT_FILE" | \
         diff --side-by-side - "$2.expected" 2>&1 > "$TEMP_DIFF_OUT"
 
     return $?
@@ -53,6 +55,10 @@ else
     TESTDIR="$2"
 fi
 
+# remaining arguments are options for the executable
+shift 2
+EXOPTIONS="$*"
+
 # we need a temporary file for the program output
 # TEMP_OUT_FILE=$(mktemp)
 TEMP_OUT_FILE="/dev/null"